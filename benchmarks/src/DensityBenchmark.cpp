@@ -0,0 +1,73 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Scatter density binning throughput, from 10^6 up to 10^9 points (streamed in chunks), compared with the bytes
+//    the text 'with points' path would send
+
+#include "gnugraph/GnuGraphDensity.h"
+#include "gnugraph/GnuGraphFormatter.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+   const size_t max_points = argc > 1 ? size_t(stod(argv[1])) : size_t(1e9);
+   const size_t chunk = 10'000'000;
+
+   // one chunk of gaussian points, reused to stream larger totals
+   vector<float> x(chunk), y(chunk);
+   mt19937_64 generator(42);
+   normal_distribution<float> normal;
+   for (size_t i = 0; i < chunk; ++i)
+   {
+      x[i] = normal(generator);
+      y[i] = 0.5f * x[i] + normal(generator);
+   }
+
+   const auto bounds = gnugraph::GnuGraphDensity::bounds(x.data(), y.data(), chunk);
+   cout << "threads: " << gnugraph::GnuGraphParallel::ranges(chunk, 1) << '\n';
+
+   for (size_t total = 1'000'000; total <= max_points; total *= 10)
+   {
+      gnugraph::GnuGraphDensity density(512, 512, bounds);
+
+      const auto start = chrono::steady_clock::now();
+      for (size_t done = 0; done < total; done += chunk)
+      {
+         const size_t n = min(chunk, total - done);
+         density.add(x.data(), y.data(), n);
+      }
+      const vector<float> image = density.image(true);
+      const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+      cout << total << " points: " << seconds << " s, " << total / seconds / 1e6 << " Mpoints/s, "
+         << image.size() * sizeof(float) << " bytes sent\n";
+   }
+
+   // what the text path would send for the first million points
+   gnugraph::GnuGraphFormatter formatter;
+   const size_t text_points = 1'000'000;
+   size_t text_bytes = 0;
+   const auto start = chrono::steady_clock::now();
+   for (size_t i = 0; i < text_points; ++i)
+      text_bytes += formatter.format(double(x[i]), double(y[i])).size() + 1;
+   const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   cout << "text path, " << text_points << " points: " << seconds << " s formatting, " << text_bytes << " bytes sent\n";
+
+   return 0;
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Bytes per point and encoding time of the compact text transport (GnuGraphPrecision), compared with the full
+//    precision text path, for a smooth signal, a noisy one and nanosecond timestamps. Also checks that every encoding
+//    reads back within tolerance, by rendering it with the native renderer next to the full precision data.
+
+#include "gnugraph/GnuGraphFormatter.h"
+#include "gnugraph/GnuGraphPrecision.h"
+#include "gnugraph/GnuGraphRenderer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+using namespace std;
+using gnugraph::GnuGraphPrecision;
+
+void compare(const string& name, const GnuGraphPrecision::Column& x, const GnuGraphPrecision::Column& y)
+{
+   const size_t n = y.size();
+
+   gnugraph::GnuGraphFormatter formatter;
+   size_t text_bytes = 0;
+   auto start = chrono::steady_clock::now();
+   for (size_t i = 0; i < n; ++i)
+      text_bytes += formatter.format(x.at(i), y.at(i)).size() + 1;
+   const double text_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+   string using_spec;
+   GnuGraphPrecision::Report report;
+   start = chrono::steady_clock::now();
+   GnuGraphPrecision::encode({ x, y }, { 800, 600 }, GnuGraphPrecision::Options(), using_spec, report);
+   const double compact_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+   cout << name << ", " << n << " points\n";
+   cout << "   full precision: " << double(text_bytes) / n << " bytes/point, " << text_seconds << " s\n";
+   cout << "   compact: " << double(report.bytes) / n << " bytes/point, " << compact_seconds << " s, using " << using_spec << '\n';
+   for (size_t c = 0; c < report.encoding.size(); ++c)
+      cout << "      column " << c + 1 << ": " << report.encoding[c] << ", max error " << report.max_error[c] << " (" << report.pixel_error[c] << " px)\n";
+}
+
+// Numbers of an svg file, in order
+vector<double> svgNumbers(const string& file)
+{
+   ifstream in(file);
+   stringstream text;
+   text << in.rdbuf();
+   const string svg = text.str();
+
+   vector<double> numbers;
+   for (const char* p = svg.c_str(); *p;)
+   {
+      char* end;
+      const double value = (isdigit(uint8_t(*p)) || *p == '-' || *p == '.') ? strtod(p, &end) : 0.0;
+      if ((isdigit(uint8_t(*p)) || *p == '-' || *p == '.') && end != p)
+      {
+         numbers.push_back(value);
+         p = end;
+      }
+      else
+         ++p;
+   }
+   return numbers;
+}
+
+string render(const string& file, const string& using_spec, const string& payload)
+{
+   gnugraph::GnuGraphRenderer::Options options;
+   options.file = file;
+   gnugraph::GnuGraphRenderer renderer(options);
+   renderer.write("plot '-' using " + using_spec + " title 'check' with lines\n" + payload + "e\n");
+   return renderer.read();
+}
+
+// Renders y both at full precision and compact, expecting the given encoding of y and the same chart within tolerance
+bool roundTrip(const string& name, const vector<double>& x, const vector<double>& y, const GnuGraphPrecision::Options& options, const string& expected)
+{
+   string full;
+   char row[64];
+   for (size_t i = 0; i < y.size(); ++i)
+   {
+      snprintf(row, sizeof(row), "%.17g %.17g\n", x[i], y[i]);
+      full += row;
+   }
+
+   string using_spec;
+   GnuGraphPrecision::Report report;
+   gnugraph::GnuGraphRenderer::Options size;
+   const string compact = GnuGraphPrecision::encode({ GnuGraphPrecision::Column::of(x, 0), GnuGraphPrecision::Column::of(y, 1) },
+      { double(size.width), double(size.height) }, options, using_spec, report);
+
+   const string messages = render("precision_check_full.svg", "1:2", full) + render("precision_check_compact.svg", using_spec, compact);
+   const vector<double> a = svgNumbers("precision_check_full.svg");
+   const vector<double> b = svgNumbers("precision_check_compact.svg");
+
+   double difference = a.size() == b.size() ? 0.0 : numeric_limits<double>::infinity();
+   for (size_t i = 0; i < a.size() && i < b.size(); ++i)
+      difference = max(difference, abs(a[i] - b[i]));
+
+   // svg coordinates are written with 6 significant digits
+   const bool ok = messages.empty() && report.encoding[1].compare(0, expected.size(), expected) == 0 && difference <= options.tolerance + 0.01;
+   cout << "   " << name << ": " << report.encoding[1] << ", using " << using_spec << ", largest svg difference " << difference
+      << (ok ? "" : "  FAILED") << '\n';
+   return ok;
+}
+
+int main(int argc, char* argv[])
+{
+   const size_t n = argc > 1 ? size_t(stod(argv[1])) : size_t(1e6);
+   cout << "threads: " << gnugraph::GnuGraphParallel::ranges(n, 1) << '\n';
+
+   vector<double> t(n), smooth(n), noisy(n);
+   vector<int64_t> stamps(n);
+   mt19937_64 generator(42);
+   normal_distribution<double> normal;
+   for (size_t i = 0; i < n; ++i)
+   {
+      t[i] = i * 1e-3;
+      smooth[i] = sin(t[i]) + 0.5 * sin(3.7 * t[i]);
+      noisy[i] = smooth[i] + 0.1 * normal(generator);
+      stamps[i] = 1'700'000'000'000'000'000 + int64_t(i) * 1'000'000 + int64_t(normal(generator) * 1000.0); // 1 kHz with jitter
+   }
+
+   compare("smooth", GnuGraphPrecision::Column::of(t, 0), GnuGraphPrecision::Column::of(smooth, 1));
+   compare("noisy", GnuGraphPrecision::Column::of(t, 0), GnuGraphPrecision::Column::of(noisy, 1));
+   compare("timestamps", GnuGraphPrecision::Column::of(stamps, 0), GnuGraphPrecision::Column::of(noisy, 1));
+
+   cout << "round trip through the native renderer\n";
+   vector<double> x(500), centred(500), shifted(500), narrow(500);
+   for (size_t i = 0; i < x.size(); ++i)
+   {
+      x[i] = i * 0.02;
+      centred[i] = 3.0 * sin(x[i]);
+      shifted[i] = 1000.0 + sin(x[i]) + 0.1 * normal(generator);
+      narrow[i] = 1e6 + 1e-10 * double(i % 7); // too many significant digits for fixed-point
+   }
+   GnuGraphPrecision::Options options;
+   GnuGraphPrecision::Options no_delta;
+   no_delta.delta = false;
+
+   bool ok = roundTrip("absolute", x, centred, no_delta, "fixed");
+   ok = roundTrip("offset", x, shifted, no_delta, "offset") && ok;
+   ok = roundTrip("delta", x, centred, options, "delta") && ok;
+   ok = roundTrip("raw", x, narrow, options, "raw") && ok;
+
+   return ok ? 0 : 1;
+}
\ No newline at end of file
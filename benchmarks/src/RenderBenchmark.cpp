@@ -0,0 +1,104 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Charts per second written by the native renderer (png and svg), and by a gnuplot process when a gnuplot
+//    executable is given (Windows only)
+
+#include "gnugraph/GnuGraph.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+template <typename Setup, typename Finish>
+double chartsPerSecond(const size_t charts, Setup setup, Finish finish)
+{
+   vector<double> x(200), y0(200), y1(200);
+   const auto start = chrono::steady_clock::now();
+   for (size_t chart = 0; chart < charts; ++chart)
+   {
+      for (size_t i = 0; i < x.size(); ++i)
+      {
+         x[i] = double(i);
+         y0[i] = sin((i + chart) / 20.0);
+         y1[i] = cos((i + chart) / 30.0);
+      }
+
+      // a fresh graph per chart, like a batch job producing one report figure at a time
+      unique_ptr<GnuGraph> graph = setup();
+      graph->addPlot(x, y0, "sin");
+      graph->addPlot(x, y1, "cos");
+      const string output = graph->plot();
+      if (!output.empty())
+         cout << output;
+      finish(*graph);
+   }
+   return charts / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+   const size_t charts = 200;
+
+   for (const string file : { "render_benchmark.png", "render_benchmark.svg" })
+   {
+      const double rate = chartsPerSecond(charts, [&file]
+      {
+         gnugraph::GnuGraphRenderer::Options options;
+         options.file = file;
+         return make_unique<GnuGraph>(options);
+      }, [](GnuGraph&) {});
+      cout << "native, " << file << ": " << rate << " charts/s\n";
+   }
+
+   if (argc > 1)
+   {
+      const string gnuplot_exe = argv[1];
+      const string frame = "output/render_benchmark_gnuplot00001.png";
+      try
+      {
+         const double rate = chartsPerSecond(charts / 10, [&gnuplot_exe, &frame]
+         {
+            filesystem::remove(frame);
+            auto graph = make_unique<GnuGraph>(gnuplot_exe);
+            graph->addImageSequence("render_benchmark_gnuplot");
+            return graph;
+         }, [&frame](GnuGraph& graph)
+         {
+            // gnuplot renders asynchronously, wait until it has written the closed file, a gnuplot that failed
+            //    (a bad path, no pngcairo terminal) never writes it
+            graph.closeOutput();
+            const auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+            while (!filesystem::exists(frame) || filesystem::file_size(frame) == 0)
+            {
+               if (chrono::steady_clock::now() > deadline)
+                  throw runtime_error("gnuplot did not write " + frame + " within 10 seconds");
+               this_thread::sleep_for(chrono::milliseconds(1));
+            }
+         });
+         cout << "gnuplot process, pngcairo: " << rate << " charts/s\n";
+      }
+      catch (const exception& e)
+      {
+         cerr << "gnuplot process: " << e.what() << "\n";
+         return 1;
+      }
+   }
+
+   return 0;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Adaptive sampling of a costly model with the default grain and serially (grain 0), reporting how many evaluation
+//    batches ran and on how many threads, so it shows whether the parallel path is taken at default settings (more
+//    batches than the serial run, on more than one thread, given more than one hardware thread)
+
+#include "gnugraph/GnuGraphSampler.h"
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace std;
+
+void run(const string& name, const gnugraph::GnuGraphSampler::Options& options)
+{
+   mutex lock;
+   set<thread::id> threads;
+   size_t batches = 0, largest = 0;
+
+   // a model costing tens of microseconds per evaluation, i.e. a small simulation
+   auto model = [&](const double* x, const size_t n, double* y)
+   {
+      for (size_t i = 0; i < n; ++i)
+      {
+         double v = x[i];
+         for (int k = 0; k < 2000; ++k)
+            v = v - 0.001 * sin(v) + 0.0005 * cos(3.0 * v);
+         y[i] = v - x[i] + sin(x[i] * x[i] * 4.0); // a chirp, so refinement passes grow to hundreds of points
+      }
+
+      lock_guard<mutex> guard(lock);
+      threads.insert(this_thread::get_id());
+      ++batches;
+      largest = max(largest, n);
+   };
+
+   vector<double> x, y;
+   const auto start = chrono::steady_clock::now();
+   gnugraph::GnuGraphSampler::sample(model, 0.0, 10.0, options, x, y);
+   const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+   cout << name << ": " << x.size() << " points in " << seconds * 1e3 << " ms, " << batches << " batches (largest " << largest
+      << ") on " << threads.size() << " thread(s)\n";
+}
+
+int main()
+{
+   cout << "hardware threads: " << max(thread::hardware_concurrency(), 1u) << '\n';
+
+   gnugraph::GnuGraphSampler::Options options;
+   run("default grain " + to_string(options.grain), options);
+
+   options.grain = 0;
+   run("serial (grain 0)", options);
+
+   return 0;
+}
\ No newline at end of file
@@ -122,6 +122,20 @@ void test6()
    pressEnter();
 }
 
+void test7()
+{
+   GnuGraph graph;
+
+   // sampled adaptively, dense only where the curves bend
+   graph.addFunction([](double x) { return sqrt(x); }, 0.0, 200.0, "y = sqrt(x)");
+   graph.addFunction([](double x) { return 5.0 * sin(x / 5.0); }, 0.0, 200.0, "y = 5 sin(x / 5)");
+   cout << "Test7:\n" << graph.plot() << '\n';
+   pressEnter();
+
+   cout << graph.plotFunction3D([](double t) { return vector<double>{ cos(t), sin(t), t / 10.0 }; }, 0.0, 60.0, "helix") << '\n';
+   pressEnter();
+}
+
 int main(int argc, char* argv[])
 {
    test1();
@@ -130,6 +144,7 @@ int main(int argc, char* argv[])
    test4();
    test5();
    test6();
+   test7();
 
    return 0;
 }
\ No newline at end of file
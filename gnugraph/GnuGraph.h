@@ -16,8 +16,13 @@
 
 #pragma once
 
+#include "gnugraph/GnuGraphCloud.h"
+#include "gnugraph/GnuGraphDensity.h"
+#include "gnugraph/GnuGraphEnsemble.h"
 #include "gnugraph/GnuGraphFormatter.h"
 #include "gnugraph/GnuGraphPiping.h"
+#include "gnugraph/GnuGraphPrecision.h"
+#include "gnugraph/GnuGraphSampler.h"
 
 #include <vector>
 #include <filesystem>
@@ -26,8 +31,28 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
 {
    GnuGraph(const std::string& gnuplot_exe_path = "C:/Program Files/gnuplot/bin/gnuplot.exe") : gnugraph::GnuGraphPiping(gnuplot_exe_path) {}
 
+   // Records everything written to gnuplot into a log for later replay (see replay/), with no live gnuplot unless
+   //    options.gnuplot_exe is set
+   GnuGraph(const gnugraph::GnuGraphRecorder::Options& options) : gnugraph::GnuGraphPiping(options) {}
+
+   // Renders 2D plots in process straight to png or svg files, for headless jobs without a gnuplot install
+   GnuGraph(const gnugraph::GnuGraphRenderer::Options& options) : gnugraph::GnuGraphPiping(options) {}
+
    void lineType(const std::string& line_type) { this->line_type = line_type; }
 
+   // Sends the series added from now on as compact fixed-point text, rounded to within options.tolerance pixels of an
+   //    options.width x options.height output (see GnuGraphPrecision), instead of at full double precision
+   void precision(const gnugraph::GnuGraphPrecision::Options& options)
+   {
+      compact = true;
+      precision_options = options;
+   }
+
+   void fullPrecision() { compact = false; }
+
+   // Encoding and error bounds of each compact series sent by the last plot
+   const std::vector<gnugraph::GnuGraphPrecision::Report>& precisionReports() const { return sent_reports; }
+
    //void clear()
    //{
    //   //initialized = false;
@@ -65,11 +90,16 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
    template <typename T> // designed for std::container<double>
    void addPlot(T& x, T& y, const std::string& title = "") // adds data to be plotted and doesn't plot yet
    {
-      std::string formatted;
-      for (unsigned i = 0; i < x.size(); ++i)
-         formatted += format(x[i], y[i]) + "\n";
+      if (compact)
+         addCompact({ Column::of(x, 0), Column::of(y, 1) }, title);
+      else
+      {
+         std::string formatted;
+         for (unsigned i = 0; i < x.size(); ++i)
+            formatted += format(x[i], y[i]) + "\n";
 
-      data.emplace_back(formatted);
+         data.emplace_back(formatted);
+      }
       if (!initialized)
          titles.push_back(title);
    }
@@ -81,6 +111,76 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
       return plot();
    }
 
+   // Plots y = f(x) over [x_min, x_max], sampled adaptively (see GnuGraphSampler) instead of filling x and y by hand.
+   //    f is double(double), or void(const double* x, size_t n, double* y) to evaluate contiguous batches.
+   //    f runs on several threads at once and must be thread-safe, set options.grain to 0 for a stateful f.
+   template <typename F>
+   void addFunction(F f, const double x_min, const double x_max, const std::string& title = "", const gnugraph::GnuGraphSampler::Options& options = {})
+   {
+      std::vector<double> x, y;
+      gnugraph::GnuGraphSampler::sample(f, x_min, x_max, options, x, y);
+
+      if (compact)
+         addCompact({ Column::of(x, 0), Column::of(y, 1) }, title);
+      else
+      {
+         std::string formatted;
+         for (size_t i = 0; i < x.size(); ++i)
+         {
+            if (std::isfinite(y[i]))
+               formatted += format(x[i], y[i]) + "\n";
+            else if (i > 0 && std::isfinite(y[i - 1]))
+               formatted += "\n"; // a blank line breaks the curve
+         }
+
+         data.emplace_back(formatted);
+      }
+      if (!initialized)
+         titles.push_back(title);
+   }
+
+   template <typename F>
+   std::string plotFunction(F f, const double x_min, const double x_max, const std::string& title = "", const gnugraph::GnuGraphSampler::Options& options = {})
+   {
+      addFunction(f, x_min, x_max, title, options);
+      return plot();
+   }
+
+   // Plots the parametric curve p = f(t) over [t_min, t_max], f returns a 3D point (i.e. Eigen::Vector3d).
+   //    As for addFunction, f must be thread-safe unless options.grain is 0.
+   template <typename F>
+   void addFunction3D(F f, const double t_min, const double t_max, const std::string& title = "", const gnugraph::GnuGraphSampler::Options& options = {})
+   {
+      std::vector<std::array<double, 3>> points;
+      gnugraph::GnuGraphSampler::sample3D(f, t_min, t_max, options, points);
+
+      if (compact)
+         addCompact(columns3D(points), title);
+      else
+      {
+         std::string formatted;
+         for (size_t i = 0; i < points.size(); ++i)
+         {
+            const auto& p = points[i];
+            if (std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]))
+               formatted += format(p[0], p[1], p[2]) + "\n";
+            else if (i > 0 && std::isfinite(points[i - 1][0]))
+               formatted += "\n";
+         }
+
+         data.emplace_back(formatted);
+      }
+      if (!initialized)
+         titles.push_back(title);
+   }
+
+   template <typename F>
+   std::string plotFunction3D(F f, const double t_min, const double t_max, const std::string& title = "", const gnugraph::GnuGraphSampler::Options& options = {})
+   {
+      addFunction3D(f, t_min, t_max, title, options);
+      return plot3D();
+   }
+
    template <typename T> // designed for a 2D point (i.e. Eigen::Vector2d)
    void addPlot2D(const T& input, const std::string& title = "")
    {
@@ -107,13 +207,18 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
    template <typename T> // designed for a std::container of vectors (i.e. std::container<Eigen::Vector3d>)
    void addLine3D(const T& input)
    {
-      std::string formatted;
-      for (unsigned i = 0; i < input.size(); ++i)
+      if (compact)
+         addCompact(columns3D(input), "");
+      else
       {
-         formatted += format(input[i]) + "\n";
-      }
+         std::string formatted;
+         for (unsigned i = 0; i < input.size(); ++i)
+         {
+            formatted += format(input[i]) + "\n";
+         }
 
-      data.emplace_back(formatted);
+         data.emplace_back(formatted);
+      }
       if (!initialized)
       {
          titles.push_back("");
@@ -123,13 +228,18 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
    template <typename T> // designed for a std::container of vectors (i.e. std::container<Eigen::Vector3d>)
    void addLine3DTitle(const T& input, const std::string& title)
    {
-      std::string formatted;
-      for (unsigned i = 0; i < input.size(); ++i)
+      if (compact)
+         addCompact(columns3D(input), title);
+      else
       {
-         formatted += format(input[i]) + "\n";
-      } 
+         std::string formatted;
+         for (unsigned i = 0; i < input.size(); ++i)
+         {
+            formatted += format(input[i]) + "\n";
+         } 
 
-      data.emplace_back(formatted);
+         data.emplace_back(formatted);
+      }
       if (!initialized)
       {
          titles.push_back(title);
@@ -208,12 +318,12 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
    {
       T segment;
 
-      string result;
+      std::string result;
 
       for (unsigned i = 0; i < input.size(); ++i)
       {
          segment.push_back(input[i]);
-         result += plot4D(segment);
+         result += plotLine3D(segment);
       }
 
       return result;
@@ -228,6 +338,147 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
          titles.push_back(title);
    }
 
+   // Scatter density: bins the points into a width x height histogram on the client and sends it as one binary image,
+   //    so the pipe cost does not depend on the number of points
+   template <typename T> // designed for std::container<double> or std::container<float>
+   void addDensity(const T& x, const T& y, const std::string& title = "", const size_t width = 512, const size_t height = 512, const bool log_scale = false)
+   {
+      const size_t n = std::min<size_t>(x.size(), y.size());
+      gnugraph::GnuGraphDensity density(width, height, gnugraph::GnuGraphDensity::bounds(x.data(), y.data(), n));
+      density.add(x.data(), y.data(), n);
+      addDensity(density, title, log_scale);
+   }
+
+   // Plots an already accumulated density grid, useful when the points are streamed in chunks
+   void addDensity(const gnugraph::GnuGraphDensity& density, const std::string& title = "", const bool log_scale = false)
+   {
+      const auto& range = density.range();
+      const double dx = (range.x_max - range.x_min) / density.columns();
+      const double dy = (range.y_max - range.y_min) / density.rows();
+
+      DataBlock block;
+      block.clause = "binary array=(" + std::to_string(density.columns()) + "," + std::to_string(density.rows()) + ") format='%float'";
+      block.clause += " dx=" + to_string_precision(dx, 12) + " dy=" + to_string_precision(dy, 12);
+      block.clause += " origin=(" + to_string_precision(range.x_min + 0.5 * dx, 12) + "," + to_string_precision(range.y_min + 0.5 * dy, 12) + ")";
+      block.clause += " title '" + title + "' with image";
+
+      const std::vector<float> image = density.image(log_scale);
+      block.payload.assign(reinterpret_cast<const char*>(image.data()), image.size() * sizeof(float));
+      block.binary = true;
+      data_blocks.push_back(std::move(block));
+   }
+
+   template <typename T> // designed for std::container<double> or std::container<float>
+   std::string plotDensity(const T& x, const T& y, const std::string& title = "", const size_t width = 512, const size_t height = 512, const bool log_scale = false)
+   {
+      addDensity(x, y, title, width, height, log_scale);
+      return plot();
+   }
+
+   // 3D point cloud: the points are downsampled to one centroid per voxel (sized for the view, see
+   //    GnuGraphCloud::Options) and sent as a single binary block, coloured by the number of points per voxel
+   template <typename T> // designed for std::container<float> or std::container<double> holding x, y, z triples
+   void addCloud(const T& xyz, const std::string& title = "", const gnugraph::GnuGraphCloud::Options& options = {})
+   {
+      addCloud(gnugraph::GnuGraphCloud::compute(xyz.data(), xyz.size() / 3, options), title);
+   }
+
+   // As addCloud, coloured by the mean of one value per point (i.e. intensity, temperature)
+   template <typename T, typename V> // designed for std::container<float> or std::container<double>
+   void addCloudValues(const T& xyz, const V& values, const std::string& title = "", const gnugraph::GnuGraphCloud::Options& options = {})
+   {
+      if (values.size() * 3 < xyz.size())
+         throw std::runtime_error("GnuGraph::addCloudValues: needs a value per point");
+      addCloud(gnugraph::GnuGraphCloud::compute(xyz.data(), xyz.size() / 3, values.data(), options), title);
+   }
+
+   void addCloud(const gnugraph::GnuGraphCloud& cloud, const std::string& title = "")
+   {
+      DataBlock block;
+      block.clause = "binary record=(" + std::to_string(cloud.points.size()) + ") format='%float%float%float%float' using 1:2:3:4";
+      block.clause += " title '" + title + "' with points pt 7 ps 0.5 palette";
+      block.payload.assign(reinterpret_cast<const char*>(cloud.points.data()), cloud.points.size() * sizeof(gnugraph::GnuGraphCloud::Point));
+      block.binary = true;
+      data_blocks.push_back(std::move(block));
+   }
+
+   template <typename T> // designed for std::container<float> or std::container<double> holding x, y, z triples
+   std::string plotCloud(const T& xyz, const std::string& title = "", const gnugraph::GnuGraphCloud::Options& options = {})
+   {
+      addCloud(xyz, title, options);
+      return plot3D();
+   }
+
+   // Ensemble plot: shaded min/max and percentile bands (outermost first), the median (if requested) and the mean.
+   //    The data sent is O(steps) however many runs went into the ensemble.
+   void addEnsemble(const gnugraph::GnuGraphEnsemble& ensemble, const std::string& title = "")
+   {
+      const std::string prefix = title.empty() ? "" : title + " ";
+      const std::string color = " lc rgb '#4682b4'";
+
+      addBand(ensemble.time, ensemble.min, ensemble.max, prefix + "min/max", 0.1, color);
+
+      const size_t n = ensemble.percentiles.size();
+      for (size_t i = 0; i < n / 2; ++i)
+      {
+         const std::string name = to_string_precision(100.0 * ensemble.percentiles[i], 3) + "-" + to_string_precision(100.0 * ensemble.percentiles[n - 1 - i], 3) + "%";
+         addBand(ensemble.time, ensemble.quantiles[i], ensemble.quantiles[n - 1 - i], prefix + name, 0.1 + 0.15 * (i + 1), color);
+      }
+
+      if (n % 2 == 1)
+         addSeries(ensemble.time, ensemble.quantiles[n / 2], prefix + to_string_precision(100.0 * ensemble.percentiles[n / 2], 3) + "%", "lw 2 lc rgb '#2b8cbe'");
+
+      addSeries(ensemble.time, ensemble.mean, prefix + "mean", "lw 2 lc rgb '#08306b'");
+   }
+
+   // Ensemble of runs stored back to back in values (runs x time.size()), highlight lists runs to draw individually
+   template <typename T> // designed for std::container<double>
+   void addEnsemble(const T& time, const T& values, const size_t runs, const std::string& title = "",
+      const std::vector<double>& percentiles = { 0.05, 0.25, 0.5, 0.75, 0.95 }, const std::vector<size_t>& highlight = {})
+   {
+      const size_t steps = time.size();
+      if (values.size() < runs * steps)
+         throw std::runtime_error("GnuGraph::addEnsemble: values must hold runs * time.size() samples");
+      for (const size_t run : highlight)
+      {
+         if (run >= runs)
+            throw std::runtime_error("GnuGraph::addEnsemble: highlighted run " + std::to_string(run) + " out of range");
+      }
+
+      addEnsemble(gnugraph::GnuGraphEnsemble::compute(time.data(), steps, values.data(), runs, percentiles), title);
+
+      for (const size_t run : highlight)
+      {
+         const std::vector<double> y(values.data() + run * steps, values.data() + (run + 1) * steps);
+         addSeries(time, y, "run " + std::to_string(run), "lw 1");
+      }
+   }
+
+   // Ensemble of runs given as a container of containers, each holding a value per time step
+   template <typename T, typename R> // designed for std::container<double> and std::container<std::container<double>>
+   void addEnsembleRuns(const T& time, const R& runs, const std::string& title = "",
+      const std::vector<double>& percentiles = { 0.05, 0.25, 0.5, 0.75, 0.95 }, const std::vector<size_t>& highlight = {})
+   {
+      for (const size_t run : highlight)
+      {
+         if (run >= runs.size())
+            throw std::runtime_error("GnuGraph::addEnsembleRuns: highlighted run " + std::to_string(run) + " out of range");
+      }
+
+      addEnsemble(gnugraph::GnuGraphEnsemble::compute(time, runs, percentiles), title);
+
+      for (const size_t run : highlight)
+         addSeries(time, runs[run], "run " + std::to_string(run), "lw 1");
+   }
+
+   template <typename T> // designed for std::container<double>
+   std::string plotEnsemble(const T& time, const T& values, const size_t runs, const std::string& title = "",
+      const std::vector<double>& percentiles = { 0.05, 0.25, 0.5, 0.75, 0.95 }, const std::vector<size_t>& highlight = {})
+   {
+      addEnsemble(time, values, runs, title, percentiles, highlight);
+      return plot();
+   }
+
    // Activates gif output from gnuplot, call this before any graphing has occured. This will save a .gif file
    //    in the active directory.
    // Note: Only one output format is allowed to be activated at a time. If more than one is called, system will
@@ -242,6 +493,7 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
 
       output_name = file_name;
       add_gif = true;
+      output_started = false;
    }
 
    // Activates image sequence output from gnuplot, call this before any graphing has occured. This will dump all
@@ -259,6 +511,7 @@ struct GnuGraph : public gnugraph::GnuGraphFormatter, public gnugraph::GnuGraphP
       output_name = file_name;
       std::filesystem::create_directories("./output");
       add_image_sequence = true;
+      output_started = false;
    }
 
    // Closes output file in gnuplot. Call this at end of graph processing to save output file.
@@ -274,16 +527,33 @@ private:
 
    std::string setup{}; // how data is to be displayed on the graph and what type of graph
    std::vector<std::string> data;
+   std::vector<std::string> data_using; // using expressions of compact data series, empty for plain columns
    std::vector<std::string> data_vectors; // data for drawing vectors
    std::vector<std::string> titles;
 
+   struct DataBlock
+   {
+      std::string clause; // everything after '-' in the plot command, including the title
+      std::string payload;
+      bool binary = false; // binary payloads are not terminated by 'e'
+   };
+   std::vector<DataBlock> data_blocks; // data that carries its own plot clause (i.e. density images)
+
    bool mode_2D = true;
    bool initialized = false;
+   std::string plotted; // last plot command sent, replot is only used while it still fits the data
+
+   using Column = gnugraph::GnuGraphPrecision::Column;
+   bool compact = false;
+   gnugraph::GnuGraphPrecision::Options precision_options;
+   std::vector<gnugraph::GnuGraphPrecision::Report> reports; // of the compact series waiting to be sent
+   std::vector<gnugraph::GnuGraphPrecision::Report> sent_reports;
 
    // GIF and Image Sequence Parameters
    bool add_image_sequence = false;  // Flag for if image sequence output is activated
    bool add_gif = false;  // Flag for if gif output is activated
    std::string output_name{};  // Name (without extension) of output file
+   bool output_started = false;  // Flag for if the terminal and output file have been sent to gnuplot
    size_t frame_id = 1;  // Id number of current frame, starts at 1. Maximum frame number is 99999 (~100 secs @ 0.01 dt)
    std::string frame;  // String version of frame ID, used internally to name image output
 
@@ -296,30 +566,40 @@ private:
          write("clear\n");
       }
 
-      if (!initialized)
+      // Check for output options, sent once so switching between 2D and 3D does not restart the output file
+      if (!output_started)
       {
-         //setup += "set term windows\n"; // gnuplot command
-         std::string title;
-         if (titles.size() > 0)
-            title = titles.front();
+         if (add_gif)
+            setupGif();
+         else if (add_image_sequence)
+            setupImageSequence();
+         output_started = true;
+      }
+
+      //setup += "set term windows\n"; // gnuplot command
+      std::string title;
+      if (titles.size() > 0)
+         title = titles.front();
 
-         setup += "plot '-' ";	// "-" for realtime plotting
-         setup += "using 1:2 ";
+      setup = "plot ";
+      if (!data.empty())
+      {
+         setup += "'-' ";	// "-" for realtime plotting
+         setup += "using " + usingSpec(0, "1:2") + " ";
          setup += "title '" + title + "' ";
          setup += "with " + line_type;
+      }
 
-         for (size_t i = 1; i < data.size(); ++i)
-         {
-            if (titles.size() == data.size())
-               title = titles[i];
-            setup += ", '-' using 1:2 title '" + title + "' with " + line_type;
-         }
-
-         setup += "\n";
-         initialized = true;
+      for (size_t i = 1; i < data.size(); ++i)
+      {
+         if (titles.size() == data.size())
+            title = titles[i];
+         setup += ", '-' using " + usingSpec(i, "1:2") + " title '" + title + "' with " + line_type;
       }
-      else
-         setup = "replot\n";
+
+      setupDataBlocks(!data.empty());
+      setup += "\n";
+      setupReplot();
    }
 
    void setup3D()
@@ -331,73 +611,186 @@ private:
          write("clear\n");
       }
 
-      if (!initialized)
+      // Check for output options, sent once so switching between 2D and 3D does not restart the output file
+      if (!output_started)
       {
-         // Check for output options
          if (add_gif)
             setupGif();
          else if (add_image_sequence)
             setupImageSequence();
+         output_started = true;
+      }
 
-         //setup += "set term windows\n"; // gnuplot command
-         std::string title;
-         if (titles.size() > 0)
-            title = titles.front();
+      //setup += "set term windows\n"; // gnuplot command
+      std::string title;
+      if (titles.size() > 0)
+         title = titles.front();
 
-         setup += "splot '-' ";	// "-" for realtime plotting
-         setup += "using 1:2:3 ";
+      setup = "splot ";
+      if (!data.empty())
+      {
+         setup += "'-' ";	// "-" for realtime plotting
+         setup += "using " + usingSpec(0, "1:2:3") + " ";
          setup += "title '" + title + "' ";
          setup += "with " + line_type;
+      }
 
-         for (size_t i = 1; i < data.size(); ++i)
-         {
-            if (titles.size() == data.size())
-               title = titles[i];
-            setup += ", '-' using 1:2:3 title '" + title + "' with " + line_type;
-         }
-
-         for (size_t i = 0; i < data_vectors.size(); ++i)
-         {
-            if (titles.size() == data_vectors.size())
-               title = titles[i];
-            setup += ", '-' using 1:2:3:4:5:6 title '" + title + "' with vectors filled head lw 2";
-         }
+      for (size_t i = 1; i < data.size(); ++i)
+      {
+         if (titles.size() == data.size())
+            title = titles[i];
+         setup += ", '-' using " + usingSpec(i, "1:2:3") + " title '" + title + "' with " + line_type;
+      }
 
-         setup += "\n";
-         initialized = true;
+      for (size_t i = 0; i < data_vectors.size(); ++i)
+      {
+         if (titles.size() == data_vectors.size())
+            title = titles[i];
+         if (!data.empty() || i > 0)
+            setup += ", ";
+         setup += "'-' using 1:2:3:4:5:6 title '" + title + "' with vectors filled head lw 2";
       }
-      else
+
+      setupDataBlocks(!data.empty() || !data_vectors.empty());
+      setup += "\n";
+      setupReplot();
+   }
+
+   std::string usingSpec(const size_t i, const std::string& plain) const
+   {
+      return i < data_using.size() && !data_using[i].empty() ? data_using[i] : plain;
+   }
+
+   // Once initialized, gnuplot replots with the previous command, unless it changed (i.e. a compact series now
+   //    needs a different unit or offset)
+   void setupReplot()
+   {
+      if (initialized && setup == plotted)
          setup = "replot\n";
+      else
+         plotted = setup;
+      initialized = true;
    }
 
-   std::string writeRead()
+   // Shaded area between low and high
+   template <typename T>
+   void addBand(const T& x, const std::vector<double>& low, const std::vector<double>& high, const std::string& title, const double opacity, const std::string& style)
    {
-      std::string input{};
+      DataBlock block;
+      std::string using_spec = "1:2:3";
+      if (compact)
+         block.payload = encodeCompact({ Column::of(x, 0), Column::of(low, 1), Column::of(high, 1) }, title, using_spec);
+      else
+      {
+         for (size_t i = 0; i < low.size(); ++i)
+            block.payload += format(double(x[i]), low[i], high[i]) + "\n";
+      }
+      block.clause = "using " + using_spec + " title '" + title + "' with filledcurves fs transparent solid " + to_string_precision(opacity, 3) + " noborder" + style;
+      data_blocks.push_back(std::move(block));
+   }
 
-      if (data.size() > 1 || data_vectors.size() > 0)
+   // Line with its own style, as opposed to the shared line_type of addPlot
+   template <typename T, typename Y>
+   void addSeries(const T& x, const Y& y, const std::string& title, const std::string& style)
+   {
+      DataBlock block;
+      std::string using_spec = "1:2";
+      if (compact)
+         block.payload = encodeCompact({ Column::of(x, 0), Column::of(y, 1) }, title, using_spec);
+      else
       {
-         for (const auto& i : data)
-            input += i + "e\n";
+         for (size_t i = 0; i < x.size(); ++i)
+            block.payload += format(double(x[i]), double(y[i])) + "\n";
+      }
+      block.clause = "using " + using_spec + " title '" + title + "' with lines " + style;
+      data_blocks.push_back(std::move(block));
+   }
 
-         for (const auto& i : data_vectors)
-            input += i + "e\n";
+   // Adds columns as a compact data series, see precision()
+   void addCompact(const std::vector<Column>& columns, const std::string& title)
+   {
+      std::string using_spec;
+      data.emplace_back(encodeCompact(columns, title, using_spec));
+      data_using.resize(data.size());
+      data_using.back() = using_spec;
+   }
 
-         write(setup + input);
+   std::string encodeCompact(const std::vector<Column>& columns, const std::string& title, std::string& using_spec)
+   {
+      // x and y map to the output width and height, the axes of a 3D view share the shorter side
+      size_t axes = 0;
+      for (const auto& column : columns)
+         axes = (std::max)(axes, column.axis + 1);
+      std::vector<double> pixels{ double(precision_options.width), double(precision_options.height) };
+      if (axes > 2)
+         pixels.assign(axes, double((std::min)(precision_options.width, precision_options.height)));
+
+      gnugraph::GnuGraphPrecision::Report report;
+      report.title = title;
+      using_spec.clear();
+      std::string payload = gnugraph::GnuGraphPrecision::encode(columns, pixels, precision_options, using_spec, report);
+      reports.push_back(std::move(report));
+      return payload;
+   }
 
-         // export frame
-         if (add_image_sequence)
-            exportImageFrame();
+   template <typename T> // designed for a std::container of 3D points (i.e. std::container<Eigen::Vector3d>)
+   static std::vector<Column> columns3D(const T& points)
+   {
+      std::vector<Column> columns(3);
+      for (size_t a = 0; a < 3; ++a)
+      {
+         columns[a].axis = a;
+         columns[a].values.reserve(points.size());
       }
-      else
+      for (const auto& p : points)
+      {
+         for (size_t a = 0; a < 3; ++a)
+            columns[a].values.push_back(double(p[a]));
+      }
+      return columns;
+   }
+
+   // Appends the plot clauses of data_blocks, after any data and vector clauses
+   void setupDataBlocks(bool separate)
+   {
+      for (const auto& block : data_blocks)
       {
-         write(setup + data.front() + "e\n");
-         
-         // export frame
-         if (add_image_sequence)
-            exportImageFrame();
+         if (separate)
+            setup += ", ";
+         setup += "'-' " + block.clause;
+         separate = true;
       }
+   }
+
+   std::string writeRead()
+   {
+      std::string input = setup;
+
+      for (const auto& i : data)
+         input += i + "e\n";
+
+      for (const auto& i : data_vectors)
+         input += i + "e\n";
+
+      for (const auto& block : data_blocks)
+      {
+         input += block.payload;
+         if (!block.binary)
+            input += "e\n";
+      }
+
+      write(input);
+
+      // export frame
+      if (add_image_sequence)
+         exportImageFrame();
+
       data.clear();
+      data_using.clear();
       data_vectors.clear();
+      data_blocks.clear();
+      sent_reports = std::move(reports);
+      reports.clear();
 
       return read();
    }
@@ -0,0 +1,388 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Voxel grid downsampling of large 3D point clouds, so millions of points can be sent to gnuplot as one binary block
+
+#include "gnugraph/GnuGraphParallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace gnugraph
+{
+   struct GnuGraphCloud
+   {
+      struct Bounds
+      {
+         double x_min, x_max, y_min, y_max, z_min, z_max;
+      };
+
+      struct Options
+      {
+         size_t resolution = 512; // pixels across the view, the voxel edge is the largest view extent over resolution
+         double pixels_per_voxel = 1.0; // raise to trade detail for fewer points
+         double voxel_size = 0.0; // fixed voxel edge in data units, overrides the view based size when set
+         size_t max_points = 0; // voxels are merged 2x2x2 (octree parents) until at most this many remain, 0 is
+                                // resolution^2, about one point per pixel of the view
+         Bounds view{}; // visible region, points outside are dropped. Empty (the default) fits all points.
+         bool downsample = true; // off sends every point in view
+      };
+
+      struct Point // layout matches format='%float%float%float%float'
+      {
+         float x, y, z, color;
+      };
+
+      std::vector<Point> points; // voxel centroids, colour is the mean value or, without values, the point count
+      std::vector<uint64_t> counts; // points merged into each of points
+      Bounds range{}; // region the voxels cover
+      double voxel = 0.0; // voxel edge used, 0 if not downsampled
+
+      // xyz holds n points as x, y, z triples (i.e. std::vector<float>::data()), Eigen points need a cast to their scalar,
+      //    reinterpret_cast<const float*>(v.data()) for a std::vector<Eigen::Vector3f> v, which is only valid while
+      //    sizeof(Eigen::Vector3f) == 3 * sizeof(float) (no padding, not the aligned Eigen::AlignedVector3)
+      template <typename T>
+      static GnuGraphCloud compute(const T* xyz, const size_t n, const Options& options)
+      {
+         return compute(xyz, n, static_cast<const float*>(nullptr), options);
+      }
+
+      // values holds one colour value per point, averaged per voxel
+      template <typename T, typename V>
+      static GnuGraphCloud compute(const T* xyz, const size_t n, const V* values, const Options& options)
+      {
+         if (options.downsample && options.voxel_size <= 0.0 && (options.resolution == 0 || !(options.pixels_per_voxel > 0.0)))
+            throw std::runtime_error("GnuGraphCloud: voxel size needs a resolution and pixels_per_voxel, or voxel_size");
+
+         GnuGraphCloud result;
+         result.range = empty(options.view) ? bounds(xyz, n) : options.view;
+         const Bounds& r = result.range;
+
+         if (!options.downsample)
+         {
+            select(xyz, n, values, result);
+            return result;
+         }
+
+         const double extent = (std::max)({ r.x_max - r.x_min, r.y_max - r.y_min, r.z_max - r.z_min, (std::numeric_limits<double>::min)() });
+         result.voxel = options.voxel_size > 0.0 ? options.voxel_size : extent * options.pixels_per_voxel / double(options.resolution);
+         result.voxel = (std::max)(result.voxel, extent / double(max_cells)); // indices must fit in their key bits
+
+         const size_t view_points = options.resolution * options.resolution;
+         const size_t budget = options.max_points > 0 ? options.max_points : view_points > 0 ? view_points : (std::numeric_limits<size_t>::max)();
+         size_t predicted;
+         result.voxel = startingVoxel(xyz, n, r, result.voxel, budget, predicted);
+
+         std::vector<std::pair<uint64_t, Cell>> cells = accumulate(xyz, n, values, result, predicted);
+         while (cells.size() > budget)
+         {
+            merge(cells);
+            result.voxel *= 2.0;
+         }
+
+         result.points.resize(cells.size());
+         result.counts.resize(cells.size());
+         for (size_t i = 0; i < cells.size(); ++i)
+         {
+            const Cell& c = cells[i].second;
+            const double count = double(c.count);
+            result.points[i] = { float(c.x / count), float(c.y / count), float(c.z / count), float(values ? c.value / count : count) };
+            result.counts[i] = c.count;
+         }
+         return result;
+      }
+
+      // Finite extent of the points
+      template <typename T>
+      static Bounds bounds(const T* xyz, const size_t n)
+      {
+         const auto e = GnuGraphParallel::extent<3>(n, [xyz](const size_t i, const size_t axis) { return double(xyz[3 * i + axis]); });
+         return Bounds{ e[0], e[1], e[2], e[3], e[4], e[5] };
+      }
+
+   private:
+      static constexpr int key_bits = 21; // bits per axis in a voxel key
+      static constexpr size_t max_cells = size_t(1) << key_bits; // voxels per axis
+      static constexpr size_t sample = 1 << 16; // points used to pick the starting voxel size
+
+      struct Cell
+      {
+         double x = 0.0, y = 0.0, z = 0.0, value = 0.0; // sums
+         uint64_t count = 0;
+
+         void add(const Cell& other)
+         {
+            x += other.x;
+            y += other.y;
+            z += other.z;
+            value += other.value;
+            count += other.count;
+         }
+      };
+
+      // Open addressing (linear probing) table of cells, far cheaper per point than a node based map
+      struct CellTable
+      {
+         static constexpr uint64_t unused = ~uint64_t(0); // no voxel key has every bit set
+         std::vector<uint64_t> keys;
+         std::vector<Cell> cells;
+         size_t size = 0;
+
+         // References are invalidated by the next insertion of a new key
+         Cell& operator[](const uint64_t key)
+         {
+            if (2 * (size + 1) > keys.size())
+               grow();
+
+            const size_t mask = keys.size() - 1;
+            for (size_t slot = size_t(mix(key)) & mask;; slot = (slot + 1) & mask)
+            {
+               if (keys[slot] == key)
+                  return cells[slot];
+               if (keys[slot] == unused)
+               {
+                  keys[slot] = key;
+                  ++size;
+                  return cells[slot];
+               }
+            }
+         }
+
+         // Room for count cells without growing
+         void reserve(const size_t count)
+         {
+            size_t slots = 64;
+            while (slots < 2 * count)
+               slots *= 2;
+            if (slots > keys.size())
+               grow(slots);
+         }
+
+         void grow(const size_t slots = 0)
+         {
+            std::vector<uint64_t> old_keys(std::max<size_t>(slots, std::max<size_t>(64, 2 * keys.size())), unused);
+            std::vector<Cell> old_cells(old_keys.size());
+            keys.swap(old_keys);
+            cells.swap(old_cells);
+            size = 0;
+            for (size_t i = 0; i < old_keys.size(); ++i)
+            {
+               if (old_keys[i] != unused)
+                  (*this)[old_keys[i]] = old_cells[i];
+            }
+         }
+      };
+
+      static bool empty(const Bounds& b)
+      {
+         return !(b.x_max > b.x_min && b.y_max > b.y_min && b.z_max > b.z_min);
+      }
+
+      static bool inside(const Bounds& b, const double x, const double y, const double z)
+      {
+         return x >= b.x_min && x <= b.x_max && y >= b.y_min && y <= b.y_max && z >= b.z_min && z <= b.z_max;
+      }
+
+      // Without downsampling: the points in range, in input order
+      template <typename T, typename V>
+      static void select(const T* xyz, const size_t n, const V* values, GnuGraphCloud& result)
+      {
+         const size_t ranges = GnuGraphParallel::ranges(n, GnuGraphParallel::point_grain);
+         std::vector<std::vector<Point>> partial(ranges);
+
+         GnuGraphParallel::forRanges(n, ranges, [&](const size_t r, const size_t begin, const size_t end)
+         {
+            for (size_t i = begin; i < end; ++i)
+            {
+               const double x = double(xyz[3 * i]), y = double(xyz[3 * i + 1]), z = double(xyz[3 * i + 2]);
+               if (inside(result.range, x, y, z))
+                  partial[r].push_back({ float(x), float(y), float(z), values ? float(values[i]) : 1.0f });
+            }
+         });
+
+         for (const auto& p : partial)
+            result.points.insert(result.points.end(), p.begin(), p.end());
+         result.counts.assign(result.points.size(), 1);
+      }
+
+      // Sums points per voxel. Every thread fills one hash table per shard of the key space, then the shards are merged
+      //    in parallel, so no table is shared between threads. Cells come back sorted by key for deterministic output.
+      template <typename T, typename V>
+      static std::vector<std::pair<uint64_t, Cell>> accumulate(const T* xyz, const size_t n, const V* values, const GnuGraphCloud& result, const size_t expected)
+      {
+         const Bounds& r = result.range;
+         const double scale = 1.0 / result.voxel;
+
+         const size_t ranges = GnuGraphParallel::ranges(n, GnuGraphParallel::point_grain);
+         const size_t shards = ranges;
+         std::vector<std::vector<CellTable>> tables(ranges, std::vector<CellTable>(shards));
+
+         GnuGraphParallel::forRanges(n, ranges, [&](const size_t t, const size_t begin, const size_t end)
+         {
+            auto& local = tables[t];
+            for (auto& table : local)
+               table.reserve((std::min)(end - begin, expected / ranges) / shards); // the tables grow if a thread sees more
+            uint64_t previous_key = ~uint64_t(0);
+            Cell* previous = nullptr; // consecutive points (scan lines, particle tracks) usually share a voxel
+
+            for (size_t i = begin; i < end; ++i)
+            {
+               const double x = double(xyz[3 * i]), y = double(xyz[3 * i + 1]), z = double(xyz[3 * i + 2]);
+               if (!inside(r, x, y, z))
+                  continue;
+
+               const uint64_t key = voxelKey(r, scale, x, y, z);
+               if (key != previous_key)
+               {
+                  previous = &local[shard(key, shards)][key]; // valid until the next new key, which refetches it
+                  previous_key = key;
+               }
+
+               previous->x += x;
+               previous->y += y;
+               previous->z += z;
+               if (values)
+                  previous->value += double(values[i]);
+               ++previous->count;
+            }
+         });
+
+         std::vector<std::vector<std::pair<uint64_t, Cell>>> merged(shards);
+         GnuGraphParallel::forRanges(shards, shards, [&](size_t, const size_t begin, const size_t end)
+         {
+            for (size_t s = begin; s < end; ++s)
+            {
+               CellTable& target = tables[0][s];
+               for (size_t t = 1; t < ranges; ++t)
+               {
+                  const CellTable& source = tables[t][s];
+                  for (size_t slot = 0; slot < source.keys.size(); ++slot)
+                  {
+                     if (source.keys[slot] != CellTable::unused)
+                        target[source.keys[slot]].add(source.cells[slot]);
+                  }
+                  tables[t][s] = CellTable(); // release memory early
+               }
+
+               merged[s].reserve(target.size);
+               for (size_t slot = 0; slot < target.keys.size(); ++slot)
+               {
+                  if (target.keys[slot] != CellTable::unused)
+                     merged[s].emplace_back(target.keys[slot], target.cells[slot]);
+               }
+               target = CellTable();
+            }
+         });
+
+         std::vector<std::pair<uint64_t, Cell>> cells;
+         for (const auto& m : merged)
+            cells.insert(cells.end(), m.begin(), m.end());
+         std::sort(cells.begin(), cells.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+         return cells;
+      }
+
+      // Coarsens the starting voxel while a sample of the points predicts far more occupied voxels than the budget,
+      //    so the full pass does not build millions of cells only to merge them away. The prediction is the GEE
+      //    distinct value estimate sqrt(n / m) f1 + (distinct - f1) of an m point sample, f1 counting voxels hit once.
+      //    predicted is the estimate for the returned voxel, which sizes the hash tables.
+      template <typename T>
+      static double startingVoxel(const T* xyz, const size_t n, const Bounds& r, double voxel, const size_t budget, size_t& predicted)
+      {
+         predicted = n;
+         if (n <= sample)
+            return voxel;
+
+         const size_t m = (std::min)(n, sample);
+         const size_t stride = n / m;
+         const double scale_up = std::sqrt(double(n) / double(m));
+         while (true)
+         {
+            CellTable table;
+            for (size_t k = 0; k < m; ++k)
+            {
+               const size_t i = k * stride;
+               const double x = double(xyz[3 * i]), y = double(xyz[3 * i + 1]), z = double(xyz[3 * i + 2]);
+               if (inside(r, x, y, z))
+                  ++table[voxelKey(r, 1.0 / voxel, x, y, z)].count;
+            }
+
+            size_t once = 0;
+            for (size_t slot = 0; slot < table.keys.size(); ++slot)
+            {
+               if (table.keys[slot] != CellTable::unused && table.cells[slot].count == 1)
+                  ++once;
+            }
+
+            // some slack, as the estimate runs high on clustered clouds and the exact merge enforces the budget anyway
+            const double estimate = scale_up * once + double(table.size - once);
+            predicted = size_t((std::min)(estimate, double(n)));
+            if (n <= budget || estimate <= 1.5 * double(budget))
+               return voxel;
+            voxel *= 2.0;
+         }
+      }
+
+      // Voxel indices packed key_bits per axis. Voxels of twice the size share the origin, so halving every index
+      //    gives the parent voxel.
+      static uint64_t voxelKey(const Bounds& r, const double scale, const double x, const double y, const double z)
+      {
+         const double last = double(max_cells - 1);
+         const uint64_t ix = uint64_t((std::min)(last, (std::max)(0.0, (x - r.x_min) * scale)));
+         const uint64_t iy = uint64_t((std::min)(last, (std::max)(0.0, (y - r.y_min) * scale)));
+         const uint64_t iz = uint64_t((std::min)(last, (std::max)(0.0, (z - r.z_min) * scale)));
+         return ix | iy << key_bits | iz << (2 * key_bits);
+      }
+
+      static uint64_t mix(uint64_t key)
+      {
+         key ^= key >> 33;
+         key *= 0xff51afd7ed558ccdull;
+         key ^= key >> 33;
+         return key;
+      }
+
+      // Shards use the high bits of the mixed key and table slots the low bits, so the two stay independent
+      static size_t shard(const uint64_t key, const size_t shards)
+      {
+         return size_t(mix(key) >> 40) % shards;
+      }
+
+      // Merges every 2x2x2 group of voxels into its parent, doubling the voxel edge
+      static void merge(std::vector<std::pair<uint64_t, Cell>>& cells)
+      {
+         const uint64_t mask = (uint64_t(1) << key_bits) - 1;
+         for (auto& cell : cells)
+         {
+            const uint64_t k = cell.first;
+            cell.first = ((k & mask) >> 1) | (((k >> key_bits) & mask) >> 1) << key_bits | (((k >> (2 * key_bits)) & mask) >> 1) << (2 * key_bits);
+         }
+         std::sort(cells.begin(), cells.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+         size_t out = 0;
+         for (size_t i = 1; i < cells.size(); ++i)
+         {
+            if (cells[i].first == cells[out].first)
+               cells[out].second.add(cells[i].second);
+            else
+               cells[++out] = cells[i];
+         }
+         cells.resize(cells.empty() ? 0 : out + 1);
+      }
+   };
+}
\ No newline at end of file
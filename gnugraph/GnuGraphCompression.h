@@ -0,0 +1,172 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// A small LZ77 byte codec (LZ4 style sequences) used to compress recorded sessions without external dependencies
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gnugraph
+{
+   struct GnuGraphCompression
+   {
+      // Each sequence is a token byte (literal length << 4 | match length - 4), optional length extension bytes,
+      // the literals, a 16 bit little endian offset and optional match length extension bytes.
+      // The final sequence carries literals only.
+      static void compress(const char* src, const size_t size, std::string& out)
+      {
+         static const size_t hash_bits = 14;
+         std::vector<uint32_t> table(size_t(1) << hash_bits, 0);
+
+         size_t anchor = 0; // start of pending literals
+         size_t ip = 0;
+         while (size >= min_match && ip + min_match <= size)
+         {
+            const uint32_t sequence = load32(src + ip);
+            const uint32_t h = (sequence * 2654435761u) >> (32 - hash_bits);
+            const size_t candidate = table[h];
+            table[h] = uint32_t(ip);
+
+            if (candidate >= ip || ip - candidate > max_offset || load32(src + candidate) != sequence)
+            {
+               ++ip;
+               continue;
+            }
+
+            size_t length = min_match;
+            while (ip + length < size && src[candidate + length] == src[ip + length])
+               ++length;
+
+            const size_t token = writeSequence(src + anchor, ip - anchor, out);
+            const size_t offset = ip - candidate;
+            out.push_back(char(offset & 0xff));
+            out.push_back(char(offset >> 8));
+            writeMatchLength(length - min_match, token, out);
+
+            ip += length;
+            anchor = ip;
+         }
+
+         // trailing literals, a match length of zero in the token signals the end
+         writeSequence(src + anchor, size - anchor, out);
+      }
+
+      static void decompress(const char* src, const size_t size, const size_t raw_size, std::string& out)
+      {
+         const size_t start = out.size();
+         out.reserve(start + raw_size);
+
+         size_t ip = 0;
+         while (ip < size)
+         {
+            const uint8_t token = uint8_t(src[ip++]);
+
+            size_t literals = token >> 4;
+            if (literals == 15)
+               literals += readLength(src, size, ip);
+            if (ip + literals > size)
+               corrupt();
+            out.append(src + ip, literals);
+            ip += literals;
+
+            if (ip == size)
+               break;
+
+            if (ip + 2 > size)
+               corrupt();
+            const size_t offset = size_t(uint8_t(src[ip])) | (size_t(uint8_t(src[ip + 1])) << 8);
+            ip += 2;
+
+            size_t length = token & 0x0f;
+            if (length == 15)
+               length += readLength(src, size, ip);
+            length += min_match;
+
+            if (offset == 0 || offset > out.size() - start)
+               corrupt();
+
+            // byte by byte so that overlapping matches repeat correctly
+            size_t from = out.size() - offset;
+            for (size_t i = 0; i < length; ++i)
+               out.push_back(out[from + i]);
+         }
+
+         if (out.size() - start != raw_size)
+            corrupt();
+      }
+
+   private:
+      static const size_t min_match = 4;
+      static const size_t max_offset = 65535;
+
+      static uint32_t load32(const char* p)
+      {
+         uint32_t value;
+         std::memcpy(&value, p, sizeof(value));
+         return value;
+      }
+
+      static void writeLengthExtension(size_t length, std::string& out)
+      {
+         while (length >= 255)
+         {
+            out.push_back(char(255));
+            length -= 255;
+         }
+         out.push_back(char(length));
+      }
+
+      // Writes the token and literals, returning the token position so the match nibble can be filled in later
+      static size_t writeSequence(const char* literals, const size_t count, std::string& out)
+      {
+         const size_t token = out.size();
+         out.push_back(char((count < 15 ? count : 15) << 4));
+         if (count >= 15)
+            writeLengthExtension(count - 15, out);
+         out.append(literals, count);
+         return token;
+      }
+
+      static void writeMatchLength(const size_t length, const size_t token, std::string& out)
+      {
+         out[token] = char(uint8_t(out[token]) | uint8_t(length < 15 ? length : 15));
+         if (length >= 15)
+            writeLengthExtension(length - 15, out);
+      }
+
+      static size_t readLength(const char* src, const size_t size, size_t& ip)
+      {
+         size_t length = 0;
+         uint8_t byte = 255;
+         while (byte == 255)
+         {
+            if (ip >= size)
+               corrupt();
+            byte = uint8_t(src[ip++]);
+            length += byte;
+         }
+         return length;
+      }
+
+      static void corrupt()
+      {
+         throw std::runtime_error("GnuGraphCompression: corrupt block");
+      }
+   };
+}
\ No newline at end of file
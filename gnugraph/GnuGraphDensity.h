@@ -0,0 +1,154 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// 2D histogram binning of scatter points, so huge scatter plots can be sent to gnuplot as a single image
+
+#include "gnugraph/GnuGraphParallel.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace gnugraph
+{
+   struct GnuGraphDensity
+   {
+      struct Bounds
+      {
+         double x_min, x_max, y_min, y_max;
+      };
+
+      // Bins cover bounds evenly, points outside of bounds (or not finite) are dropped
+      GnuGraphDensity(const size_t width, const size_t height, const Bounds& bounds) : width(width), height(height), limits(bounds)
+      {
+         if (width == 0 || height == 0)
+            throw std::runtime_error("GnuGraphDensity: resolution must be non-zero");
+
+         if (!(limits.x_max > limits.x_min))
+         {
+            limits.x_min -= 0.5;
+            limits.x_max = limits.x_min + 1.0;
+         }
+         if (!(limits.y_max > limits.y_min))
+         {
+            limits.y_min -= 0.5;
+            limits.y_max = limits.y_min + 1.0;
+         }
+
+         counts.assign(width * height, 0);
+      }
+
+      // Finite extent of the points
+      template <typename T>
+      static Bounds bounds(const T* x, const T* y, const size_t n)
+      {
+         const auto e = GnuGraphParallel::extent<2>(n, [x, y](const size_t i, const size_t axis) { return double(axis == 0 ? x[i] : y[i]); });
+         return Bounds{ e[0], e[1], e[2], e[3] };
+      }
+
+      // Accumulates points, may be called repeatedly to stream in more points than fit in memory at once
+      template <typename T>
+      void add(const T* x, const T* y, size_t n)
+      {
+         // per-thread tiles count in 32 bits, so limit how many points a single pass can put in one bin
+         const size_t max_pass = size_t(1) << 31;
+         while (n > max_pass)
+         {
+            add(x, y, max_pass);
+            x += max_pass;
+            y += max_pass;
+            n -= max_pass;
+         }
+
+         const size_t bins = counts.size();
+         const size_t ranges = GnuGraphParallel::ranges(n, GnuGraphParallel::point_grain);
+         std::vector<std::vector<uint32_t>> tiles(ranges);
+
+         GnuGraphParallel::forRanges(n, ranges, [&](const size_t r, const size_t begin, const size_t end)
+         {
+            auto& tile = tiles[r];
+            tile.assign(bins + 1, 0); // the extra bin collects dropped points
+
+            uint32_t index[batch];
+            for (size_t i = begin; i < end; i += batch)
+            {
+               const size_t count = (std::min)(batch, end - i);
+               binIndices(x + i, y + i, count, index);
+               for (size_t k = 0; k < count; ++k)
+                  ++tile[index[k]];
+            }
+         });
+
+         // reduce the tiles, split across threads by bin
+         GnuGraphParallel::forRanges(bins, GnuGraphParallel::ranges(bins, GnuGraphParallel::point_grain), [&](size_t, const size_t begin, const size_t end)
+         {
+            for (const auto& tile : tiles)
+            {
+               for (size_t b = begin; b < end; ++b)
+                  counts[b] += tile[b];
+            }
+         });
+      }
+
+      size_t columns() const { return width; }
+      size_t rows() const { return height; }
+      const Bounds& range() const { return limits; }
+      uint64_t count(const size_t column, const size_t row) const { return counts[row * width + column]; }
+
+      // Row major image (row 0 at y_min) of the counts, or log10(1 + count) if log_scale is set
+      std::vector<float> image(const bool log_scale = false) const
+      {
+         std::vector<float> result(counts.size());
+         for (size_t b = 0; b < counts.size(); ++b)
+            result[b] = log_scale ? float(std::log10(1.0 + double(counts[b]))) : float(counts[b]);
+         return result;
+      }
+
+   private:
+      static constexpr size_t batch = 256; // points per bin index kernel call
+
+      size_t width, height;
+      Bounds limits;
+      std::vector<uint64_t> counts;
+
+      // Branch free bin index computation that compilers can vectorize, dropped points map to the extra bin
+      template <typename T>
+      void binIndices(const T* x, const T* y, const size_t count, uint32_t* index) const
+      {
+         const double x_scale = double(width) / (limits.x_max - limits.x_min);
+         const double y_scale = double(height) / (limits.y_max - limits.y_min);
+         const double x_last = double(width - 1);
+         const double y_last = double(height - 1);
+         const uint32_t dropped = uint32_t(width * height);
+         const uint32_t stride = uint32_t(width);
+
+         for (size_t k = 0; k < count; ++k)
+         {
+            const double fx = (double(x[k]) - limits.x_min) * x_scale;
+            const double fy = (double(y[k]) - limits.y_min) * y_scale;
+
+            // the upper bound is inclusive so points exactly at x_max or y_max land in the last bin
+            const bool inside = fx >= 0.0 && fx <= double(width) && fy >= 0.0 && fy <= double(height);
+
+            // argument order keeps NaN out of the integer conversion
+            const uint32_t ix = uint32_t((std::min)(x_last, (std::max)(0.0, fx)));
+            const uint32_t iy = uint32_t((std::min)(y_last, (std::max)(0.0, fy)));
+            index[k] = inside ? iy * stride + ix : dropped;
+         }
+      }
+   };
+}
\ No newline at end of file
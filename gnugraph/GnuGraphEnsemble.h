@@ -0,0 +1,270 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Per time step statistics (mean, min/max, percentiles) of an ensemble of runs sharing a time axis
+
+#include "gnugraph/GnuGraphParallel.h"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace gnugraph
+{
+   // P-square streaming quantile estimator (Jain & Chlamtac, 1985), constant memory per quantile
+   struct GnuGraphQuantile
+   {
+      GnuGraphQuantile(const double p = 0.5) : p(p) {}
+
+      // Non-finite samples are skipped, a NaN compares false against every marker and an infinity would become one
+      void add(const double x)
+      {
+         if (!std::isfinite(x))
+            return;
+
+         if (count < 5)
+         {
+            q[count++] = x;
+            if (count == 5)
+            {
+               std::sort(q, q + 5);
+               for (int i = 0; i < 5; ++i)
+                  n[i] = i;
+               desired[0] = 0.0;
+               desired[1] = 2.0 * p;
+               desired[2] = 4.0 * p;
+               desired[3] = 2.0 + 2.0 * p;
+               desired[4] = 4.0;
+            }
+            return;
+         }
+         ++count;
+
+         int k;
+         if (x < q[0])
+         {
+            q[0] = x;
+            k = 0;
+         }
+         else if (x >= q[4])
+         {
+            q[4] = x;
+            k = 3;
+         }
+         else
+         {
+            k = 0;
+            while (x >= q[k + 1])
+               ++k;
+         }
+
+         for (int i = k + 1; i < 5; ++i)
+            ++n[i];
+
+         const double increment[5] = { 0.0, p / 2.0, p, (1.0 + p) / 2.0, 1.0 };
+         for (int i = 0; i < 5; ++i)
+            desired[i] += increment[i];
+
+         for (int i = 1; i < 4; ++i)
+         {
+            const double d = desired[i] - n[i];
+            if ((d >= 1.0 && n[i + 1] - n[i] > 1) || (d <= -1.0 && n[i - 1] - n[i] < -1))
+            {
+               const int step = d > 0.0 ? 1 : -1;
+               const double candidate = parabolic(i, step);
+               if (q[i - 1] < candidate && candidate < q[i + 1])
+                  q[i] = candidate;
+               else
+                  q[i] += step * (q[i + step] - q[i]) / (n[i + step] - n[i]);
+               n[i] += step;
+            }
+         }
+      }
+
+      double value() const
+      {
+         if (count >= 5)
+            return q[2];
+         if (count == 0)
+            return std::numeric_limits<double>::quiet_NaN();
+
+         // too few samples for the markers, interpolate the sorted samples
+         double sorted[5];
+         std::copy(q, q + count, sorted);
+         std::sort(sorted, sorted + count);
+         const double position = p * (count - 1);
+         const size_t below = size_t(position);
+         const size_t above = (std::min)(below + 1, count - 1);
+         return sorted[below] + (position - below) * (sorted[above] - sorted[below]);
+      }
+
+   private:
+      double p;
+      size_t count = 0;
+      double q[5]{}; // marker heights
+      int n[5]{}; // marker positions
+      double desired[5]{}; // desired marker positions
+
+      double parabolic(const int i, const int step) const
+      {
+         const double d = step;
+         return q[i] + d / (n[i + 1] - n[i - 1]) * ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i])
+            + (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+      }
+   };
+
+   struct GnuGraphEnsemble
+   {
+      std::vector<double> time;
+      std::vector<double> mean, min, max;
+      std::vector<double> percentiles; // requested probabilities, ascending in (0, 1)
+      std::vector<std::vector<double>> quantiles; // quantiles[i][t] is percentiles[i] at time step t
+
+      // values is contiguous run major storage, values[run * steps + t]. Non-finite values (failed runs) are skipped,
+      //    a time step without any finite value has NaN statistics.
+      // Time steps are split across threads and every thread streams the runs through its P-square estimators, so
+      //    memory use is independent of the number of runs. exact selects the quantiles exactly instead, which needs
+      //    a column copy per time step.
+      template <typename T, typename V>
+      static GnuGraphEnsemble compute(const T* time, const size_t steps, const V* values, const size_t runs, const std::vector<double>& percentiles, const bool exact = false)
+      {
+         return compute(time, steps, runs, percentiles, exact, [values, steps](const size_t run, const size_t t) { return double(values[run * steps + t]); });
+      }
+
+      // runs is a container of containers (i.e. std::vector<std::vector<double>>), each holding one value per time step
+      template <typename T, typename R>
+      static GnuGraphEnsemble compute(const T& time, const R& runs, const std::vector<double>& percentiles, const bool exact = false)
+      {
+         for (const auto& run : runs)
+         {
+            if (run.size() < time.size())
+               throw std::runtime_error("GnuGraphEnsemble: every run needs a value per time step");
+         }
+
+         return compute(time.data(), time.size(), runs.size(), percentiles, exact, [&runs](const size_t run, const size_t t) { return double(runs[run][t]); });
+      }
+
+   private:
+      static const size_t grain = 64; // time steps per thread worth spawning for
+
+      template <typename T, typename Value>
+      static GnuGraphEnsemble compute(const T* time, const size_t steps, const size_t runs, const std::vector<double>& percentiles, const bool exact, Value value)
+      {
+         if (runs == 0)
+            throw std::runtime_error("GnuGraphEnsemble: no runs");
+         for (size_t i = 0; i < percentiles.size(); ++i)
+         {
+            if (!(percentiles[i] > 0.0 && percentiles[i] < 1.0) || (i > 0 && percentiles[i] <= percentiles[i - 1]))
+               throw std::runtime_error("GnuGraphEnsemble: percentiles must be ascending and within (0, 1)");
+         }
+
+         GnuGraphEnsemble result;
+         result.time.assign(time, time + steps);
+         result.mean.resize(steps);
+         result.min.resize(steps);
+         result.max.resize(steps);
+         result.percentiles = percentiles;
+         result.quantiles.assign(percentiles.size(), std::vector<double>(steps));
+
+         GnuGraphParallel::forRanges(steps, GnuGraphParallel::ranges(steps, grain), [&](size_t, const size_t begin, const size_t end)
+         {
+            const size_t count = end - begin;
+            std::vector<size_t> finite(count, 0);
+            std::vector<double> sum(count, 0.0);
+            std::vector<double> low(count, std::numeric_limits<double>::infinity());
+            std::vector<double> high(count, -std::numeric_limits<double>::infinity());
+
+            std::vector<GnuGraphQuantile> estimators;
+            if (!exact)
+            {
+               estimators.reserve(count * percentiles.size());
+               for (size_t t = 0; t < count; ++t)
+               {
+                  for (const double p : percentiles)
+                     estimators.emplace_back(p);
+               }
+            }
+
+            // runs outer, so run major storage is read sequentially
+            for (size_t run = 0; run < runs; ++run)
+            {
+               for (size_t t = 0; t < count; ++t)
+               {
+                  const double v = value(run, begin + t);
+                  if (!std::isfinite(v))
+                     continue;
+
+                  ++finite[t];
+                  sum[t] += v;
+                  low[t] = (std::min)(low[t], v);
+                  high[t] = (std::max)(high[t], v);
+
+                  if (!exact)
+                  {
+                     for (size_t i = 0; i < percentiles.size(); ++i)
+                        estimators[t * percentiles.size() + i].add(v);
+                  }
+               }
+            }
+
+            const double nan = std::numeric_limits<double>::quiet_NaN();
+            std::vector<double> column;
+            column.reserve(exact ? runs : 0);
+            for (size_t t = 0; t < count; ++t)
+            {
+               result.mean[begin + t] = finite[t] > 0 ? sum[t] / finite[t] : nan;
+               result.min[begin + t] = finite[t] > 0 ? low[t] : nan;
+               result.max[begin + t] = finite[t] > 0 ? high[t] : nan;
+
+               if (exact)
+               {
+                  column.clear();
+                  for (size_t run = 0; run < runs; ++run)
+                  {
+                     const double v = value(run, begin + t);
+                     if (std::isfinite(v))
+                        column.push_back(v);
+                  }
+               }
+
+               for (size_t i = 0; i < percentiles.size(); ++i)
+               {
+                  result.quantiles[i][begin + t] = exact ? select(column, percentiles[i]) : estimators[t * percentiles.size() + i].value();
+               }
+            }
+         });
+
+         return result;
+      }
+
+      // Linearly interpolated quantile, reorders column
+      static double select(std::vector<double>& column, const double p)
+      {
+         if (column.empty())
+            return std::numeric_limits<double>::quiet_NaN();
+
+         const double position = p * (column.size() - 1);
+         const size_t below = size_t(position);
+         std::nth_element(column.begin(), column.begin() + below, column.end());
+         const double lower = column[below];
+         if (below + 1 >= column.size())
+            return lower;
+
+         const double upper = *std::min_element(column.begin() + below + 1, column.end());
+         return lower + (position - below) * (upper - lower);
+      }
+   };
+}
\ No newline at end of file
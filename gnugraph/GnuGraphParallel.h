@@ -0,0 +1,145 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Minimal fork/join helpers for the client side data reduction
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace gnugraph
+{
+   struct GnuGraphParallel
+   {
+      static constexpr size_t point_grain = 1 << 16; // points per thread worth spawning for in the cheap per point passes
+
+      // Number of contiguous ranges to split n items into, so that each range holds at least grain items
+      static size_t ranges(const size_t n, const size_t grain)
+      {
+         const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+         const size_t by_work = grain > 0 ? (n + grain - 1) / grain : n;
+         return std::max<size_t>((std::min)(hardware, by_work), 1);
+      }
+
+      // Calls f(range, begin, end) for each of the contiguous ranges of [0, n), one thread per range.
+      // The first range runs on the calling thread, and the first exception thrown by any range is rethrown here.
+      template <typename F>
+      static void forRanges(const size_t n, const size_t ranges, F f)
+      {
+         const size_t step = (n + ranges - 1) / ranges;
+         std::vector<std::exception_ptr> errors(ranges);
+
+         auto run = [&f, &errors, step, n](const size_t r)
+         {
+            try
+            {
+               const size_t begin = (std::min)(r * step, n);
+               f(r, begin, (std::min)(begin + step, n));
+            }
+            catch (...)
+            {
+               errors[r] = std::current_exception();
+            }
+         };
+
+         std::vector<std::thread> threads;
+         threads.reserve(ranges);
+         for (size_t r = 1; r < ranges; ++r)
+            threads.emplace_back(run, r);
+
+         run(0);
+
+         for (auto& thread : threads)
+            thread.join();
+
+         for (const auto& error : errors)
+         {
+            if (error)
+               std::rethrow_exception(error);
+         }
+      }
+
+      template <typename F>
+      static void forRanges(const size_t n, F f)
+      {
+         forRanges(n, ranges(n, 1), f);
+      }
+
+      // Finite extent of n points of Dims coordinates, coordinate(i, axis) gives the coordinate of point i along axis.
+      // Returns the minimum and maximum per axis in turn, or [0, 1] on every axis if no point has all coordinates finite.
+      template <size_t Dims, typename Coordinate>
+      static std::array<double, 2 * Dims> extent(const size_t n, Coordinate coordinate)
+      {
+         std::array<double, 2 * Dims> empty;
+         for (size_t axis = 0; axis < Dims; ++axis)
+         {
+            empty[2 * axis] = std::numeric_limits<double>::infinity();
+            empty[2 * axis + 1] = -std::numeric_limits<double>::infinity();
+         }
+
+         const size_t count = ranges(n, point_grain);
+         std::vector<std::array<double, 2 * Dims>> partial(count, empty);
+
+         forRanges(n, count, [&](const size_t r, const size_t begin, const size_t end)
+         {
+            auto e = partial[r];
+            double point[Dims];
+            for (size_t i = begin; i < end; ++i)
+            {
+               bool finite = true;
+               for (size_t axis = 0; axis < Dims; ++axis)
+               {
+                  point[axis] = coordinate(i, axis);
+                  finite = finite && std::isfinite(point[axis]);
+               }
+               if (!finite)
+                  continue;
+
+               for (size_t axis = 0; axis < Dims; ++axis)
+               {
+                  e[2 * axis] = (std::min)(e[2 * axis], point[axis]);
+                  e[2 * axis + 1] = (std::max)(e[2 * axis + 1], point[axis]);
+               }
+            }
+            partial[r] = e;
+         });
+
+         auto result = empty;
+         for (const auto& e : partial)
+         {
+            for (size_t axis = 0; axis < Dims; ++axis)
+            {
+               result[2 * axis] = (std::min)(result[2 * axis], e[2 * axis]);
+               result[2 * axis + 1] = (std::max)(result[2 * axis + 1], e[2 * axis + 1]);
+            }
+         }
+
+         if (result[0] > result[1]) // no finite points
+         {
+            for (size_t axis = 0; axis < Dims; ++axis)
+            {
+               result[2 * axis] = 0.0;
+               result[2 * axis + 1] = 1.0;
+            }
+         }
+         return result;
+      }
+   };
+}
\ No newline at end of file
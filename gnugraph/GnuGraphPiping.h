@@ -16,8 +16,17 @@
 
 #pragma once
 
+#include "gnugraph/GnuGraphRecorder.h"
+#include "gnugraph/GnuGraphRenderer.h"
+
 #include <iostream>
+#include <memory>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // keep std::min and std::max usable in the headers included after this one
+#endif
 #include <windows.h>
+#endif
 
 namespace gnugraph
 {
@@ -29,10 +38,34 @@ namespace gnugraph
          startProcess();
       }
 
+      // Records the command stream to a log instead of (or as well as, if options.gnuplot_exe is set) driving gnuplot
+      GnuGraphPiping(const GnuGraphRecorder::Options& options) : gnuplot_exe(options.gnuplot_exe), recorder(std::make_unique<GnuGraphRecorder>(options))
+      {
+         if (!gnuplot_exe.empty())
+         {
+            createPipes();
+            startProcess();
+         }
+      }
+
+      // Renders plots in process to png or svg files (see GnuGraphRenderer), no gnuplot is started
+      GnuGraphPiping(const GnuGraphRenderer::Options& options) : renderer(std::make_unique<GnuGraphRenderer>(options)) {}
+
       ~GnuGraphPiping()
       {
-         write("quit\n"); // command gnuplot to quit
+         try
+         {
+            write("quit\n"); // command gnuplot to quit
+         }
+         catch (const std::exception&)
+         {
+            // a destructor must not throw, recording failures are reported by closeRecording()
+         }
+
+         if (!process_started)
+            return;
 
+#ifdef _WIN32
          // Close the handle to the process and thread
          CloseHandle(process_information.hProcess);
          CloseHandle(process_information.hThread);
@@ -45,6 +78,18 @@ namespace gnugraph
             errorExit("StdInWr CloseHandle");
          if (!CloseHandle(output_write_handle))
             errorExit("StdInWr CloseHandle");
+#endif
+      }
+
+      // Ends the recording and closes its log, throws if any of the log failed to write. Later commands are not recorded.
+      void closeRecording()
+      {
+         if (!recorder)
+            return;
+
+         const auto closing = std::move(recorder);
+         closing->write("quit\n"); // recorded as the destructor would
+         closing->close();
       }
 
    private:
@@ -52,6 +97,7 @@ namespace gnugraph
       static const unsigned long buffer_size = 4096;
       const std::string gnuplot_exe;
 
+#ifdef _WIN32
       // Pipe handle variables:
       HANDLE input_read_handle; // child process read-pipe handle
       HANDLE input_write_handle;	// parent process write-pipe handle
@@ -59,6 +105,11 @@ namespace gnugraph
       HANDLE output_write_handle; // child process write-pipe handle
 
       PROCESS_INFORMATION process_information; // process information struct
+#endif
+      bool process_started = false;
+
+      std::unique_ptr<GnuGraphRecorder> recorder; // set when recording the session
+      std::unique_ptr<GnuGraphRenderer> renderer; // set when rendering natively
 
    protected:
       void errorExit(const std::string& description)
@@ -68,15 +119,28 @@ namespace gnugraph
 
       void write(const std::string& command)
       {
+         if (recorder)
+            recorder->write(command);
+         if (renderer)
+            renderer->write(command);
+         if (!process_started)
+            return;
+
+#ifdef _WIN32
          size_t to_write = command.length();
          unsigned long written = 0;
          int success = WriteFile(input_write_handle, command.c_str(), (DWORD)to_write, &written, nullptr);
          if (!success || written != to_write)
             errorExit("GnuGraph::write");
+#endif
       }
 
       std::string read() // Read the reply from gnuplot.exe
       {
+         if (!process_started)
+            return renderer ? renderer->read() : std::string{}; // no gnuplot, only the native renderer replies
+
+#ifdef _WIN32
          /* Peek the pipe to see if data is available to be read. If no data available
          *	then don't try and read (i.e. prevent ReadFile from blocking by not calling it). */
          unsigned long total_bytes_available;
@@ -96,6 +160,9 @@ namespace gnugraph
 
          std::string result(char_buf);
          return result;
+#else
+         return {};
+#endif
       }
 
       /* This function simply creates the pipes used to interface with gnuplot.exe.
@@ -104,6 +171,7 @@ namespace gnugraph
       */
       void createPipes()
       {
+#ifdef _WIN32
          SECURITY_ATTRIBUTES saAttr;
          saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
          saAttr.bInheritHandle = true; // Set the bInheritHandle flag so pipe handles are inherited. 
@@ -124,6 +192,9 @@ namespace gnugraph
          // Ensure the read handle to the pipe for STDOUT is not inherited. 
          if (!SetHandleInformation(output_read_handle, HANDLE_FLAG_INHERIT, 0))
             errorExit("Stdin SetHandleInformation");
+#else
+         errorExit("GnuGraphPiping: driving a gnuplot process is only supported on Windows");
+#endif
       }
 
       /* This function starts the gnuplot.exe process and sets the appropriate pipe
@@ -132,6 +203,7 @@ namespace gnugraph
       */
       void startProcess()
       {
+#ifdef _WIN32
          STARTUPINFO StartInfo;
          // Set up members of the PROCESS_INFORMATION structure. 
          ZeroMemory(&process_information, sizeof(PROCESS_INFORMATION));
@@ -168,6 +240,8 @@ namespace gnugraph
          {
             errorExit("CreateProcess");
          }
+         process_started = true;
+#endif
       }
    };
 }
\ No newline at end of file
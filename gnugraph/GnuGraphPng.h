@@ -0,0 +1,236 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Minimal PNG encoder (8 bit RGB, deflate with fixed Huffman codes) for the native renderer
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gnugraph
+{
+   struct GnuGraphPng
+   {
+      // rgb holds height rows of width * 3 bytes
+      static std::string encode(const uint8_t* rgb, const size_t width, const size_t height)
+      {
+         // every row uses the 'up' filter (the first row has a zero row above it), flat chart backgrounds become zeros
+         const size_t stride = width * 3;
+         std::string raw((stride + 1) * height, char(0));
+         for (size_t y = 0; y < height; ++y)
+         {
+            const uint8_t* row = rgb + y * stride;
+            uint8_t* filtered = reinterpret_cast<uint8_t*>(&raw[y * (stride + 1)]);
+            filtered[0] = 2;
+            if (y == 0)
+               std::copy(row, row + stride, filtered + 1);
+            else
+            {
+               for (size_t i = 0; i < stride; ++i)
+                  filtered[i + 1] = uint8_t(row[i] - row[i - stride]);
+            }
+         }
+
+         std::string zlib;
+         zlib.push_back(char(0x78)); // deflate, 32K window
+         zlib.push_back(char(0x01));
+         deflate(reinterpret_cast<const uint8_t*>(raw.data()), raw.size(), zlib);
+         putBigEndian(adler32(reinterpret_cast<const uint8_t*>(raw.data()), raw.size()), zlib);
+
+         std::string png("\x89PNG\r\n\x1a\n", 8);
+
+         std::string header;
+         putBigEndian(uint32_t(width), header);
+         putBigEndian(uint32_t(height), header);
+         header += std::string("\x08\x02\x00\x00\x00", 5); // 8 bit depth, RGB, default compression, filter and no interlace
+
+         chunk("IHDR", header, png);
+         chunk("IDAT", zlib, png);
+         chunk("IEND", std::string(), png);
+         return png;
+      }
+
+   private:
+      static void putBigEndian(const uint32_t value, std::string& out)
+      {
+         out.push_back(char(value >> 24));
+         out.push_back(char(value >> 16));
+         out.push_back(char(value >> 8));
+         out.push_back(char(value));
+      }
+
+      static void chunk(const char* type, const std::string& data, std::string& png)
+      {
+         putBigEndian(uint32_t(data.size()), png);
+         const size_t start = png.size();
+         png.append(type, 4);
+         png += data;
+         putBigEndian(crc32(reinterpret_cast<const uint8_t*>(png.data() + start), png.size() - start), png);
+      }
+
+      static uint32_t crc32(const uint8_t* data, const size_t size)
+      {
+         static const std::vector<uint32_t> table = []
+         {
+            std::vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+               uint32_t c = n;
+               for (int k = 0; k < 8; ++k)
+                  c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+               t[n] = c;
+            }
+            return t;
+         }();
+
+         uint32_t crc = 0xffffffffu;
+         for (size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+         return crc ^ 0xffffffffu;
+      }
+
+      static uint32_t adler32(const uint8_t* data, const size_t size)
+      {
+         uint32_t a = 1, b = 0;
+         size_t i = 0;
+         while (i < size)
+         {
+            const size_t end = (std::min)(size, i + 5552); // largest run that cannot overflow before the modulo
+            for (; i < end; ++i)
+            {
+               a += data[i];
+               b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+         }
+         return (b << 16) | a;
+      }
+
+      struct BitWriter
+      {
+         std::string& out;
+         uint64_t bits = 0;
+         int count = 0;
+
+         void put(const uint32_t value, const int n) // least significant bit first
+         {
+            bits |= uint64_t(value) << count;
+            count += n;
+            while (count >= 8)
+            {
+               out.push_back(char(bits & 0xff));
+               bits >>= 8;
+               count -= 8;
+            }
+         }
+
+         void putHuffman(const uint32_t code, const int n) // Huffman codes go most significant bit first
+         {
+            uint32_t reversed = 0;
+            for (int i = 0; i < n; ++i)
+               reversed |= ((code >> i) & 1) << (n - 1 - i);
+            put(reversed, n);
+         }
+
+         void flush()
+         {
+            if (count > 0)
+               out.push_back(char(bits & 0xff));
+            bits = 0;
+            count = 0;
+         }
+      };
+
+      static void literal(BitWriter& writer, const uint32_t symbol)
+      {
+         if (symbol < 144)
+            writer.putHuffman(0x30 + symbol, 8);
+         else if (symbol < 256)
+            writer.putHuffman(0x190 + symbol - 144, 9);
+         else if (symbol < 280)
+            writer.putHuffman(symbol - 256, 7);
+         else
+            writer.putHuffman(0xc0 + symbol - 280, 8);
+      }
+
+      static void match(BitWriter& writer, const uint32_t length, const uint32_t distance)
+      {
+         static const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+         static const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+         static const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+         static const uint8_t distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+         int l = 28;
+         while (length_base[l] > length)
+            --l;
+         literal(writer, 257 + l);
+         writer.put(length - length_base[l], length_extra[l]);
+
+         int d = 29;
+         while (distance_base[d] > distance)
+            --d;
+         writer.putHuffman(d, 5);
+         writer.put(distance - distance_base[d], distance_extra[d]);
+      }
+
+      // One fixed Huffman block, greedy matching with a single candidate per hash
+      static void deflate(const uint8_t* data, const size_t size, std::string& out)
+      {
+         static const size_t window = 32768;
+         static const size_t max_match = 258;
+         static const int hash_bits = 15;
+         std::vector<int64_t> head(size_t(1) << hash_bits, -1);
+
+         BitWriter writer{ out };
+         writer.put(1, 1); // final block
+         writer.put(1, 2); // fixed Huffman codes
+
+         size_t i = 0;
+         while (i < size)
+         {
+            size_t length = 0;
+            size_t distance = 0;
+            if (i + 3 <= size)
+            {
+               const uint32_t h = ((uint32_t(data[i]) << 16 | uint32_t(data[i + 1]) << 8 | data[i + 2]) * 2654435761u) >> (32 - hash_bits);
+               const int64_t candidate = head[h];
+               head[h] = int64_t(i);
+
+               if (candidate >= 0 && i - size_t(candidate) <= window)
+               {
+                  const size_t limit = (std::min)(max_match, size - i);
+                  while (length < limit && data[size_t(candidate) + length] == data[i + length])
+                     ++length;
+                  distance = i - size_t(candidate);
+               }
+            }
+
+            if (length >= 3)
+            {
+               match(writer, uint32_t(length), uint32_t(distance));
+               i += length;
+            }
+            else
+               literal(writer, data[i++]);
+         }
+
+         literal(writer, 256); // end of block
+         writer.flush();
+      }
+   };
+}
\ No newline at end of file
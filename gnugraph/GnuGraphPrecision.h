@@ -0,0 +1,449 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Compact text encoding of plot data: every column is rounded to the coarsest fixed-point unit that stays within a
+//    fraction of a pixel of its axis, and sent as small integers that gnuplot scales back in the using expression
+
+#include "gnugraph/GnuGraphParallel.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace gnugraph
+{
+   struct GnuGraphPrecision
+   {
+      struct Options
+      {
+         size_t width = 800; // output resolution in pixels
+         size_t height = 600;
+         double tolerance = 0.1; // largest rounding error allowed per value, in pixels of its axis
+         bool delta = true; // allow sending differences between rows, for slowly varying or monotonic columns
+      };
+
+      // One column of a series. Integral input keeps its exact 64 bit values (i.e. nanosecond timestamps).
+      struct Column
+      {
+         std::vector<double> values;
+         std::vector<int64_t> integers; // used instead of values for integral input
+         size_t axis = 0; // columns on the same axis share its range and resolution
+
+         template <typename C> // designed for std::container<double>, std::container<float> or std::container<int64_t>
+         static Column of(const C& container, const size_t axis)
+         {
+            Column column;
+            column.axis = axis;
+            using T = typename std::decay<decltype(container[0])>::type;
+            if constexpr (std::is_integral<T>::value)
+               column.integers.assign(container.begin(), container.end());
+            else
+               column.values.assign(container.begin(), container.end());
+            return column;
+         }
+
+         bool integral() const { return !integers.empty(); }
+         size_t size() const { return integral() ? integers.size() : values.size(); }
+         double at(const size_t i) const { return integral() ? double(integers[i]) : values[i]; }
+      };
+
+      struct Report
+      {
+         std::string title;
+         size_t rows = 0;
+         size_t bytes = 0; // payload size
+         std::vector<double> max_error; // per column, the largest difference between the data and what gnuplot reads back
+         std::vector<double> pixel_error; // the same, in pixels of the column's axis
+         std::vector<std::string> encoding; // per column, i.e. "delta 0.001"
+      };
+
+      // Formats the rows of columns, a blank line replacing rows with a non-finite value, and sets using_spec to the
+      //    expressions that decode them. axis_pixels[a] is the resolution of axis a.
+      static std::string encode(const std::vector<Column>& columns, const std::vector<double>& axis_pixels, const Options& options,
+         std::string& using_spec, Report& report)
+      {
+         if (columns.empty())
+            throw std::runtime_error("GnuGraphPrecision: no columns");
+
+         size_t n = columns.front().size();
+         for (const auto& column : columns)
+         {
+            n = (std::min)(n, column.size());
+            if (column.axis >= axis_pixels.size())
+               throw std::runtime_error("GnuGraphPrecision: column axis without a resolution");
+         }
+
+         const size_t ranges = GnuGraphParallel::ranges(n, grain);
+         std::vector<uint8_t> valid(n);
+         GnuGraphParallel::forRanges(n, ranges, [&](size_t, const size_t begin, const size_t end)
+         {
+            for (size_t i = begin; i < end; ++i)
+            {
+               valid[i] = 1;
+               for (const auto& column : columns)
+               {
+                  if (!column.integral() && !std::isfinite(column.values[i]))
+                     valid[i] = 0;
+               }
+            }
+         });
+
+         // delta decoding relies on gnuplot's row counter and the previous row, so it needs an unbroken series
+         bool breaks = false;
+         bool started = false;
+         for (size_t i = 1; i < n && !breaks; ++i)
+         {
+            started = started || valid[i - 1];
+            breaks = started && valid[i] && !valid[i - 1];
+         }
+
+         // axis ranges over the valid rows
+         std::vector<double> low(axis_pixels.size(), std::numeric_limits<double>::infinity());
+         std::vector<double> high(axis_pixels.size(), -std::numeric_limits<double>::infinity());
+         for (const auto& column : columns)
+         {
+            const Extent e = extent(column, valid);
+            low[column.axis] = (std::min)(low[column.axis], e.low);
+            high[column.axis] = (std::max)(high[column.axis], e.high);
+         }
+
+         std::vector<Plan> plans(columns.size());
+         std::vector<std::vector<int64_t>> quantized(columns.size());
+         for (size_t c = 0; c < columns.size(); ++c)
+         {
+            plans[c] = plan(columns[c], low[columns[c].axis], high[columns[c].axis], axis_pixels[columns[c].axis], options, !breaks, valid, quantized[c]);
+            if (c > 0)
+               using_spec += ":";
+            using_spec += expression(plans[c], c + 1);
+         }
+
+         // format in parallel, each range into its own string
+         std::vector<std::string> parts(ranges);
+         GnuGraphParallel::forRanges(n, ranges, [&](const size_t r, const size_t begin, const size_t end)
+         {
+            std::string& out = parts[r];
+            out.reserve((end - begin) * columns.size() * 4);
+            char buffer[32];
+
+            for (size_t i = begin; i < end; ++i)
+            {
+               if (!valid[i])
+               {
+                  if (i > 0 && valid[i - 1])
+                     out += '\n'; // a blank line breaks the curve
+                  continue;
+               }
+
+               for (size_t c = 0; c < columns.size(); ++c)
+               {
+                  const Plan& p = plans[c];
+                  char* last;
+                  if (p.mode == Mode::raw)
+                  {
+                     last = columns[c].integral() ? std::to_chars(buffer, buffer + sizeof(buffer), columns[c].integers[i]).ptr
+                        : std::to_chars(buffer, buffer + sizeof(buffer), columns[c].values[i]).ptr;
+                  }
+                  else
+                  {
+                     const int64_t q = quantized[c][i];
+                     const int64_t sent = p.mode == Mode::offset ? q - p.offset : p.mode == Mode::delta ? q - previous(quantized[c], valid, i) : q;
+                     last = std::to_chars(buffer, buffer + sizeof(buffer), sent).ptr;
+                  }
+
+                  if (c > 0)
+                     out += ' ';
+                  out.append(buffer, last);
+               }
+               out += '\n';
+            }
+         });
+
+         std::string payload;
+         size_t total = 0;
+         for (const auto& part : parts)
+            total += part.size();
+         payload.reserve(total);
+         for (const auto& part : parts)
+            payload += part;
+
+         report.rows = size_t(std::count(valid.begin(), valid.end(), 1));
+         report.bytes = payload.size();
+         report.max_error.clear();
+         report.pixel_error.clear();
+         report.encoding.clear();
+         for (size_t c = 0; c < columns.size(); ++c)
+         {
+            const double span = plans[c].span;
+            report.max_error.push_back(plans[c].max_error);
+            report.pixel_error.push_back(span > 0.0 ? plans[c].max_error * axis_pixels[columns[c].axis] / span : 0.0);
+            report.encoding.push_back(describe(plans[c]));
+         }
+         return payload;
+      }
+
+   private:
+      static constexpr size_t grain = 1 << 14; // rows per thread worth spawning for
+      static constexpr double exact_limit = 9007199254740992.0; // 2^53, gnuplot reads data as doubles
+
+      enum class Mode { raw, absolute, offset, delta };
+
+      struct Plan
+      {
+         Mode mode = Mode::raw;
+         double unit = 1.0; // sent integers are multiples of unit
+         int64_t offset = 0;
+         double max_error = 0.0;
+         double span = 0.0; // axis range the unit was chosen for
+      };
+
+      struct Extent
+      {
+         double low, high;
+      };
+
+      static Extent extent(const Column& column, const std::vector<uint8_t>& valid)
+      {
+         Extent e{ std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+         for (size_t i = 0; i < valid.size(); ++i)
+         {
+            if (valid[i])
+            {
+               const double v = column.at(i);
+               e.low = (std::min)(e.low, v);
+               e.high = (std::max)(e.high, v);
+            }
+         }
+         return e;
+      }
+
+      // Largest 1, 2 or 5 times a power of ten that is at most limit, as mantissa * 10^exponent
+      static void unitBelow(const double limit, int64_t& mantissa, int& exponent)
+      {
+         exponent = int(std::floor(std::log10(limit)));
+         mantissa = 1;
+         for (const int64_t step : { 5, 2 })
+         {
+            if (decimal(step, exponent) <= limit * (1.0 + 1e-12))
+            {
+               mantissa = step;
+               break;
+            }
+         }
+      }
+
+      // Nearest double to mantissa * 10^exponent, so that it prints back as the short decimal
+      static double decimal(const int64_t mantissa, const int exponent)
+      {
+         return exponent < 0 ? double(mantissa) / std::pow(10.0, -exponent) : double(mantissa) * std::pow(10.0, exponent);
+      }
+
+      static size_t digits(const int64_t v)
+      {
+         uint64_t magnitude = v < 0 ? 0 - uint64_t(v) : uint64_t(v);
+         size_t count = v < 0 ? 2 : 1;
+         while (magnitude >= 10)
+         {
+            magnitude /= 10;
+            ++count;
+         }
+         return count;
+      }
+
+      static int64_t previous(const std::vector<int64_t>& quantized, const std::vector<uint8_t>& valid, const size_t i)
+      {
+         return i > 0 && valid[i - 1] ? quantized[i - 1] : 0; // the first row is sent whole, delta series have no breaks
+      }
+
+      // Picks the unit and the cheapest of the absolute, offset and delta forms, and rounds the column to the unit
+      static Plan plan(const Column& column, const double low, const double high, const double pixels, const Options& options,
+         const bool delta_safe, const std::vector<uint8_t>& valid, std::vector<int64_t>& quantized)
+      {
+         Plan p;
+         if (!(low <= high))
+            return p; // no valid rows
+
+         double span = high - low;
+         if (span <= 0.0)
+            span = low != 0.0 ? std::abs(low) : 1.0; // constant column, keep it within a tolerance of its own magnitude
+         p.span = span;
+         int64_t mantissa;
+         int exponent;
+         unitBelow(2.0 * options.tolerance * span / (std::max)(pixels, 1.0), mantissa, exponent);
+         if (column.integral() && exponent < 0)
+         {
+            mantissa = 1; // integers are never made finer than themselves
+            exponent = 0;
+         }
+         const double unit = decimal(mantissa, exponent);
+
+         if ((std::max)(std::abs(low), std::abs(high)) / unit >= exact_limit)
+            return p; // too many significant digits for fixed-point, send as is
+
+         // round to the unit, tracking the largest error and the cost of each form
+         const size_t n = valid.size();
+         quantized.resize(n);
+         const size_t ranges = GnuGraphParallel::ranges(n, grain);
+         std::vector<double> errors(ranges, 0.0);
+         std::vector<int64_t> minimum(ranges, (std::numeric_limits<int64_t>::max)()), maximum(ranges, (std::numeric_limits<int64_t>::min)());
+         std::vector<int64_t> divisors(ranges, 0);
+         GnuGraphParallel::forRanges(n, ranges, [&](const size_t r, const size_t begin, const size_t end)
+         {
+            for (size_t i = begin; i < end; ++i)
+            {
+               if (!valid[i])
+                  continue;
+
+               int64_t q;
+               if (column.integral())
+               {
+                  const int64_t u = int64_t(unit), v = column.integers[i];
+                  q = v >= 0 ? (v + u / 2) / u : -((u / 2 - v) / u); // exact integer rounding, no trip through double
+                  errors[r] = (std::max)(errors[r], std::abs(double(q * u - v)));
+               }
+               else
+               {
+                  const double v = column.values[i];
+                  q = std::llround(v / unit);
+                  errors[r] = (std::max)(errors[r], std::abs(double(q) * unit - v));
+               }
+               quantized[i] = q;
+               minimum[r] = (std::min)(minimum[r], q);
+               maximum[r] = (std::max)(maximum[r], q);
+               divisors[r] = std::gcd(divisors[r], q);
+            }
+         });
+
+         p.max_error = *std::max_element(errors.begin(), errors.end());
+         int64_t q_low = *std::min_element(minimum.begin(), minimum.end());
+         int64_t q_high = *std::max_element(maximum.begin(), maximum.end());
+
+         // data already on a coarser grid (i.e. integers, or steps of 0.05) is sent in that grid's unit, without loss
+         int64_t divisor = 0;
+         for (const int64_t d : divisors)
+            divisor = std::gcd(divisor, d);
+         if (divisor > 1)
+         {
+            GnuGraphParallel::forRanges(n, ranges, [&](size_t, const size_t begin, const size_t end)
+            {
+               for (size_t i = begin; i < end; ++i)
+                  quantized[i] /= divisor;
+            });
+            q_low /= divisor;
+            q_high /= divisor;
+            mantissa *= divisor;
+         }
+         p.unit = decimal(mantissa, exponent);
+         const int64_t offset = q_low + (q_high - q_low) / 2;
+
+         std::vector<size_t> absolute(ranges, 0), centred(ranges, 0), differences(ranges, 0);
+         GnuGraphParallel::forRanges(n, ranges, [&](const size_t r, const size_t begin, const size_t end)
+         {
+            for (size_t i = begin; i < end; ++i)
+            {
+               if (!valid[i])
+                  continue;
+               absolute[r] += digits(quantized[i]);
+               centred[r] += digits(quantized[i] - offset);
+               differences[r] += digits(quantized[i] - previous(quantized, valid, i));
+            }
+         });
+
+         // the expression is sent once, so count its length against the bytes it saves
+         auto cost = [&](const std::vector<size_t>& bytes, const Plan& candidate)
+         {
+            size_t total = expression(candidate, 1).size();
+            for (const size_t b : bytes)
+               total += b;
+            return total;
+         };
+
+         Plan best = p;
+         best.mode = Mode::absolute;
+         size_t best_cost = cost(absolute, best);
+
+         Plan candidate = p;
+         candidate.mode = Mode::offset;
+         candidate.offset = offset;
+         if (offset != 0 && cost(centred, candidate) < best_cost)
+         {
+            best = candidate;
+            best_cost = cost(centred, candidate);
+         }
+
+         candidate = p;
+         candidate.mode = Mode::delta;
+         if (options.delta && delta_safe && cost(differences, candidate) < best_cost)
+            best = candidate;
+
+         return best;
+      }
+
+      static std::string number(const double v)
+      {
+         char buffer[32];
+         return std::string(buffer, std::to_chars(buffer, buffer + sizeof(buffer), v).ptr);
+      }
+
+      // using expression reading column c back, i.e. ((gg_2=($0==0?0:gg_2)+$2)*0.001) for a delta column
+      static std::string expression(const Plan& p, const size_t c)
+      {
+         const std::string column = "$" + std::to_string(c);
+         std::string decoded;
+         switch (p.mode)
+         {
+         case Mode::raw:
+         case Mode::absolute:
+            if (p.unit == 1.0)
+               return std::to_string(c);
+            decoded = column;
+            break;
+         case Mode::offset:
+            decoded = "(" + column + (p.offset < 0 ? "" : "+") + std::to_string(p.offset) + ")";
+            break;
+         case Mode::delta:
+         {
+            const std::string sum = "gg_" + std::to_string(c);
+            decoded = "(" + sum + "=($0==0?0:" + sum + ")+" + column + ")";
+            break;
+         }
+         }
+         return p.unit == 1.0 ? "(" + decoded + ")" : "(" + decoded + "*" + number(p.unit) + ")";
+      }
+
+      static std::string describe(const Plan& p)
+      {
+         switch (p.mode)
+         {
+         case Mode::raw:
+            return "raw";
+         case Mode::absolute:
+            return "fixed " + number(p.unit);
+         case Mode::offset:
+            return "offset " + number(p.unit);
+         case Mode::delta:
+            return "delta " + number(p.unit);
+         }
+         return std::string();
+      }
+   };
+}
\ No newline at end of file
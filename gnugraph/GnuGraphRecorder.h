@@ -0,0 +1,286 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Session recording: captures the exact command/data stream sent to gnuplot so it can be replayed later
+
+#include "gnugraph/GnuGraphCompression.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace gnugraph
+{
+   // Log layout: an 8 byte header ("GGREC", version, flags, reserved) followed by blocks of
+   //    [uint32 raw size][uint32 stored size][stored bytes]
+   // The raw bytes of a block are whole frames of
+   //    [uint64 nanoseconds since the recording started][uint32 length][command bytes]
+   // and are stored compressed with GnuGraphCompression when the compressed flag is set.
+   // Integers are written in native byte order.
+   namespace record
+   {
+      static const char magic[5] = { 'G', 'G', 'R', 'E', 'C' };
+      static const char version = 1;
+      static const char flag_compressed = 1;
+      static const size_t header_size = 8;
+      static const size_t frame_header_size = sizeof(uint64_t) + sizeof(uint32_t);
+   }
+
+   struct GnuGraphRecorder
+   {
+      struct Options
+      {
+         std::string file; // path of the log to write
+         bool compress = false; // compress blocks on the writer thread
+         std::string gnuplot_exe{}; // if set, a live gnuplot is driven as well as the recording
+         size_t block_size = 1 << 20; // bytes buffered before a block is handed to the writer thread
+      };
+
+      GnuGraphRecorder(const Options& options) : options(options), start(std::chrono::steady_clock::now())
+      {
+         file = std::fopen(options.file.c_str(), "wb");
+         if (!file)
+            throw std::runtime_error("GnuGraphRecorder: unable to open " + options.file);
+
+         char header[record::header_size]{};
+         std::memcpy(header, record::magic, sizeof(record::magic));
+         header[5] = record::version;
+         header[6] = options.compress ? record::flag_compressed : 0;
+         std::fwrite(header, 1, sizeof(header), file);
+
+         front.reserve(options.block_size + (options.block_size >> 2));
+         back.reserve(front.capacity());
+         writer = std::thread([this] { writerLoop(); });
+      }
+
+      // Write failures found while closing here are lost, call close() first to have them reported
+      ~GnuGraphRecorder()
+      {
+         stop();
+      }
+
+      // Writes the remaining frames and closes the log, throws if any of the log failed to write
+      void close()
+      {
+         if (!stop())
+            throw std::runtime_error("GnuGraphRecorder: unable to write " + options.file);
+      }
+
+      // Appends one frame, this is a timestamp and a copy into the front buffer, all I/O happens on the writer thread
+      void write(const std::string& command)
+      {
+         const uint64_t time = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+         const uint32_t length = uint32_t(command.size());
+
+         char frame_header[record::frame_header_size];
+         std::memcpy(frame_header, &time, sizeof(time));
+         std::memcpy(frame_header + sizeof(time), &length, sizeof(length));
+
+         bool notify = false;
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failed || stopping)
+               throw std::runtime_error("GnuGraphRecorder: unable to write " + options.file);
+
+            front.append(frame_header, sizeof(frame_header));
+            front.append(command);
+            notify = handOff();
+         }
+         if (notify)
+            ready.notify_one();
+      }
+
+   private:
+      const Options options;
+      const std::chrono::steady_clock::time_point start;
+      std::FILE* file = nullptr;
+
+      std::string front; // frames being recorded
+      std::string back; // block owned by the writer thread while pending is set
+      std::string compressed;
+      bool pending = false;
+      bool stopping = false;
+      bool failed = false;
+
+      std::mutex mutex;
+      std::condition_variable ready;
+      std::thread writer;
+
+      // Stops the writer thread once it has written the front buffer and closes the file, returns false on any failure
+      bool stop()
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping)
+               return !failed;
+            stopping = true;
+         }
+         ready.notify_one();
+         writer.join();
+
+         const bool closed = std::fclose(file) == 0;
+         std::lock_guard<std::mutex> lock(mutex);
+         failed = failed || !closed;
+         return !failed;
+      }
+
+      // Swaps a full front buffer to the writer if it is idle, otherwise recording keeps appending to front
+      bool handOff()
+      {
+         if (pending || front.size() < options.block_size)
+            return false;
+
+         front.swap(back);
+         pending = true;
+         return true;
+      }
+
+      void writerLoop()
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         while (true)
+         {
+            ready.wait(lock, [this] { return pending || stopping; });
+
+            if (!pending)
+            {
+               // stopping, flush whatever is left in the front buffer
+               front.swap(back);
+               pending = !back.empty();
+               if (!pending)
+                  return;
+            }
+
+            lock.unlock();
+            writeBlock(back);
+            lock.lock();
+
+            back.clear(); // keeps its capacity for the next swap
+            pending = false;
+            handOff();
+         }
+      }
+
+      void writeBlock(const std::string& raw)
+      {
+         const std::string* stored = &raw;
+         if (options.compress)
+         {
+            compressed.clear();
+            GnuGraphCompression::compress(raw.data(), raw.size(), compressed);
+            stored = &compressed;
+         }
+
+         const uint32_t sizes[2] = { uint32_t(raw.size()), uint32_t(stored->size()) };
+         bool ok = std::fwrite(sizes, sizeof(sizes), 1, file) == 1;
+         ok = ok && std::fwrite(stored->data(), 1, stored->size(), file) == stored->size();
+         if (!ok)
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+         }
+      }
+   };
+
+   // Sequential reader for logs written by GnuGraphRecorder
+   struct GnuGraphRecording
+   {
+      struct Frame
+      {
+         uint64_t time = 0; // nanoseconds since the recording started
+         std::string command;
+      };
+
+      GnuGraphRecording(const std::string& file_name)
+      {
+         file = std::fopen(file_name.c_str(), "rb");
+         if (!file)
+            throw std::runtime_error("GnuGraphRecording: unable to open " + file_name);
+
+         char header[record::header_size];
+         if (std::fread(header, 1, sizeof(header), file) != sizeof(header) || std::memcmp(header, record::magic, sizeof(record::magic)) != 0 || header[5] != record::version)
+         {
+            std::fclose(file);
+            throw std::runtime_error("GnuGraphRecording: " + file_name + " is not a gnugraph recording");
+         }
+         compressed = (header[6] & record::flag_compressed) != 0;
+      }
+
+      ~GnuGraphRecording()
+      {
+         std::fclose(file);
+      }
+
+      GnuGraphRecording(const GnuGraphRecording&) = delete;
+      GnuGraphRecording& operator=(const GnuGraphRecording&) = delete;
+
+      // Reads the next frame, returns false at the end of the log
+      bool next(Frame& frame)
+      {
+         if (position == block.size() && !readBlock())
+            return false;
+
+         if (block.size() - position < record::frame_header_size)
+            corrupt();
+
+         uint32_t length;
+         std::memcpy(&frame.time, block.data() + position, sizeof(frame.time));
+         std::memcpy(&length, block.data() + position + sizeof(frame.time), sizeof(length));
+         position += record::frame_header_size;
+
+         if (block.size() - position < length)
+            corrupt();
+
+         frame.command.assign(block.data() + position, length);
+         position += length;
+         return true;
+      }
+
+   private:
+      std::FILE* file = nullptr;
+      bool compressed = false;
+      std::string block;
+      std::string stored;
+      size_t position = 0;
+
+      bool readBlock()
+      {
+         uint32_t sizes[2];
+         if (std::fread(sizes, sizeof(sizes), 1, file) != 1)
+            return false;
+
+         stored.resize(sizes[1]);
+         if (std::fread(&stored[0], 1, stored.size(), file) != stored.size())
+            corrupt();
+
+         block.clear();
+         if (compressed)
+            GnuGraphCompression::decompress(stored.data(), stored.size(), sizes[0], block);
+         else
+            block.swap(stored);
+
+         position = 0;
+         return true;
+      }
+
+      void corrupt()
+      {
+         throw std::runtime_error("GnuGraphRecording: truncated or corrupt recording");
+      }
+   };
+}
\ No newline at end of file
@@ -0,0 +1,1250 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// In process renderer for 2D plots: reads the same command stream GnuGraph sends to gnuplot and writes png or svg
+//    files directly, so headless jobs need no gnuplot process
+
+#include "gnugraph/GnuGraphFont.h"
+#include "gnugraph/GnuGraphPng.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace gnugraph
+{
+   struct GnuGraphRenderer
+   {
+      struct Options
+      {
+         std::string file = "chart.png"; // .svg selects svg output, a %d is replaced by the plot number
+         size_t width = 640;
+         size_t height = 480;
+         std::string title{}; // chart title, 'set title' in the command stream replaces it
+      };
+
+      GnuGraphRenderer(const Options& options) : options(options), output(options.file), title(options.title) {}
+
+      // Consumes commands and inline data, a plot is rendered as soon as all of its data blocks have arrived
+      void write(const std::string& command)
+      {
+         input += command;
+         parse();
+         input.erase(0, position);
+         position = 0;
+      }
+
+      // Messages for anything that could not be rendered, the equivalent of gnuplot's error output
+      std::string read()
+      {
+         std::string result;
+         result.swap(messages);
+         return result;
+      }
+
+   private:
+      // Reads back a using expression such as ($2*0.01), (($2-150)*0.01) or ((gg_2=($0==0?0:gg_2)+$2)*0.01)
+      struct Decode
+      {
+         double scale = 1.0;
+         double offset = 0.0;
+         bool delta = false; // running sum of the column, from the first row
+
+         bool identity() const { return scale == 1.0 && offset == 0.0 && !delta; }
+      };
+
+      struct Series
+      {
+         std::string style = "lines";
+         std::string title;
+         std::vector<int> columns; // from 'using', 0 is the row number
+         std::vector<Decode> decode; // per entry of columns, for the fixed-point expressions of GnuGraphPrecision
+         uint32_t color = 0;
+         bool has_color = false;
+         double line_width = 1.0;
+         double fill_opacity = 1.0;
+         bool filled_head = false;
+
+         bool binary = false;
+         size_t binary_bytes = 0;
+         size_t array_width = 0, array_height = 0;
+         double dx = 1.0, dy = 1.0, origin_x = 0.0, origin_y = 0.0;
+
+         std::vector<std::vector<double>> rows; // an empty row is a break (blank line)
+         std::vector<float> values; // binary data
+      };
+
+      enum class Kind { polyline, polygon, rect, text, image };
+
+      struct Primitive // display list entry, in pixels with y down
+      {
+         Primitive(const Kind kind) : kind(kind) {}
+
+         Kind kind;
+         std::vector<double> points; // x, y pairs, or x, y, width, height for rect and image
+         uint32_t color = 0;
+         double opacity = 1.0;
+         double width = 1.0;
+         bool clip = false; // clipped to the plot area
+         std::string text;
+         int anchor = 0; // text: 0 left, 1 centre, 2 right
+         int scale = 1;
+         std::vector<uint8_t> rgba; // image: image_width x image_height, top row first, alpha 0 for missing cells
+         size_t image_width = 0, image_height = 0;
+      };
+
+      const Options options;
+      std::string output;
+      std::string title, xlabel, ylabel;
+      size_t frame = 0;
+
+      std::string input;
+      size_t position = 0;
+      std::string messages;
+
+      std::vector<Series> series;
+      size_t block = 0; // next series waiting for data
+      bool receiving = false;
+      bool surface = false; // splot, data is consumed but not drawn
+
+      // plot area, in pixels
+      double left = 0, right = 0, top = 0, bottom = 0;
+      double x_min = 0, x_max = 1, y_min = 0, y_max = 1;
+
+      void parse()
+      {
+         while (true)
+         {
+            if (receiving)
+            {
+               if (block == series.size())
+               {
+                  receiving = false;
+                  if (surface)
+                     messages += "GnuGraphRenderer: splot is not supported by the native renderer\n";
+                  else
+                     render();
+                  continue;
+               }
+
+               Series& s = series[block];
+               if (s.binary)
+               {
+                  if (input.size() - position < s.binary_bytes)
+                     return;
+                  s.values.resize(s.binary_bytes / sizeof(float));
+                  std::memcpy(s.values.data(), input.data() + position, s.values.size() * sizeof(float));
+                  position += s.binary_bytes;
+                  ++block;
+                  continue;
+               }
+
+               std::string line;
+               if (!nextLine(line))
+                  return;
+               if (trim(line) == "e")
+               {
+                  decode(s);
+                  ++block;
+               }
+               else
+                  s.rows.push_back(parseRow(line));
+               continue;
+            }
+
+            std::string line;
+            if (!nextLine(line))
+               return;
+            command(trim(line));
+         }
+      }
+
+      bool nextLine(std::string& line)
+      {
+         const size_t end = input.find('\n', position);
+         if (end == std::string::npos)
+            return false;
+         line.assign(input, position, end - position);
+         position = end + 1;
+         return true;
+      }
+
+      static std::string trim(const std::string& text)
+      {
+         const size_t begin = text.find_first_not_of(" \t\r");
+         if (begin == std::string::npos)
+            return std::string();
+         const size_t end = text.find_last_not_of(" \t\r");
+         return text.substr(begin, end - begin + 1);
+      }
+
+      static bool startsWith(const std::string& text, const char* prefix)
+      {
+         return text.compare(0, std::strlen(prefix), prefix) == 0;
+      }
+
+      static std::string unquote(const std::string& text)
+      {
+         if (text.size() >= 2 && (text.front() == '\'' || text.front() == '"') && text.back() == text.front())
+            return text.substr(1, text.size() - 2);
+         return text;
+      }
+
+      static std::vector<double> parseRow(const std::string& line)
+      {
+         std::vector<double> row;
+         const char* p = line.c_str();
+         while (*p)
+         {
+            char* end;
+            const double value = std::strtod(p, &end);
+            if (end == p)
+            {
+               // not a number, skip the field
+               while (*p && *p != ' ' && *p != '\t')
+                  ++p;
+               while (*p == ' ' || *p == '\t' || *p == '\r')
+                  ++p;
+               if (*p)
+                  row.push_back(std::numeric_limits<double>::quiet_NaN());
+               continue;
+            }
+            row.push_back(value);
+            p = end;
+            while (*p == ' ' || *p == '\t' || *p == '\r')
+               ++p;
+         }
+         return row;
+      }
+
+      // Splits on separator outside of quotes and parentheses
+      static std::vector<std::string> split(const std::string& text, const char separator)
+      {
+         std::vector<std::string> parts(1);
+         char quote = 0;
+         int depth = 0;
+         for (const char c : text)
+         {
+            if (quote)
+            {
+               if (c == quote)
+                  quote = 0;
+            }
+            else if (c == '\'' || c == '"')
+               quote = c;
+            else if (c == '(')
+               ++depth;
+            else if (c == ')')
+               --depth;
+            else if (c == separator && depth == 0)
+            {
+               parts.emplace_back();
+               continue;
+            }
+            parts.back() += c;
+         }
+         return parts;
+      }
+
+      void command(const std::string& line)
+      {
+         if (startsWith(line, "plot ") || startsWith(line, "splot "))
+         {
+            surface = line[0] == 's';
+            series.clear();
+            for (const auto& clause : split(line.substr(line.find(' ') + 1), ','))
+               series.push_back(parseClause(trim(clause)));
+            startReceiving();
+         }
+         else if (startsWith(line, "replot"))
+            startReceiving();
+         else if (startsWith(line, "set output "))
+            output = unquote(trim(line.substr(11)));
+         else if (startsWith(line, "set title "))
+            title = unquote(trim(line.substr(10)));
+         else if (startsWith(line, "set xlabel "))
+            xlabel = unquote(trim(line.substr(11)));
+         else if (startsWith(line, "set ylabel "))
+            ylabel = unquote(trim(line.substr(11)));
+         // everything else (clear, quit, set terminal, ...) does not affect the native output
+      }
+
+      void startReceiving()
+      {
+         for (auto& s : series)
+         {
+            s.rows.clear();
+            s.values.clear();
+         }
+         block = 0;
+         receiving = true;
+      }
+
+      Series parseClause(const std::string& clause)
+      {
+         Series s;
+         const std::vector<std::string> tokens = split(clause, ' ');
+
+         size_t records = 0, fields = 0;
+         for (size_t i = 0; i < tokens.size(); ++i)
+         {
+            const std::string& token = tokens[i];
+            const bool has_next = i + 1 < tokens.size();
+
+            if ((token == "using" || token == "u") && has_next)
+            {
+               for (const auto& column : split(tokens[++i], ':'))
+               {
+                  Decode d;
+                  s.columns.push_back(parseUsing(column, d));
+                  s.decode.push_back(d);
+               }
+            }
+            else if ((token == "title" || token == "t") && has_next)
+               s.title = unquote(tokens[++i]);
+            else if ((token == "with" || token == "w") && has_next)
+               s.style = tokens[++i];
+            else if ((token == "lw" || token == "linewidth") && has_next)
+               s.line_width = std::atof(tokens[++i].c_str());
+            else if ((token == "lc" || token == "linecolor") && i + 2 < tokens.size() && tokens[i + 1] == "rgb")
+            {
+               const std::string color = unquote(tokens[i + 2]);
+               if (color.size() == 7 && color[0] == '#')
+               {
+                  s.color = uint32_t(std::strtoul(color.c_str() + 1, nullptr, 16));
+                  s.has_color = true;
+               }
+               i += 2;
+            }
+            else if (token == "solid" && has_next && std::isdigit(uint8_t(tokens[i + 1][0])))
+               s.fill_opacity = std::atof(tokens[++i].c_str());
+            else if (token == "filled")
+               s.filled_head = true;
+            else if (token == "binary")
+               s.binary = true;
+            else if (startsWith(token, "array="))
+            {
+               const auto size = split(unquote(token.substr(6)).substr(1), ',');
+               s.array_width = size_t(std::atoll(size[0].c_str()));
+               s.array_height = size.size() > 1 ? size_t(std::atoll(size[1].c_str())) : 1;
+               records = s.array_width * s.array_height;
+            }
+            else if (startsWith(token, "record="))
+               records = size_t(std::atoll(token.c_str() + 8));
+            else if (startsWith(token, "format="))
+            {
+               const std::string format = token.substr(7);
+               for (size_t k = format.find("%float"); k != std::string::npos; k = format.find("%float", k + 1))
+                  ++fields;
+            }
+            else if (startsWith(token, "dx="))
+               s.dx = std::atof(token.c_str() + 3);
+            else if (startsWith(token, "dy="))
+               s.dy = std::atof(token.c_str() + 3);
+            else if (startsWith(token, "origin="))
+            {
+               const auto origin = split(token.substr(8, token.size() - 9), ',');
+               s.origin_x = std::atof(origin[0].c_str());
+               s.origin_y = origin.size() > 1 ? std::atof(origin[1].c_str()) : 0.0;
+            }
+         }
+
+         if (s.binary)
+            s.binary_bytes = records * std::max<size_t>(fields, 1) * sizeof(float);
+         return s;
+      }
+
+      // Column read by a using entry, either a plain number or an expression over one $n
+      static int parseUsing(const std::string& entry, Decode& d)
+      {
+         size_t k = entry.find('$');
+         while (k != std::string::npos && (k + 1 >= entry.size() || entry[k + 1] == '0' || !std::isdigit(uint8_t(entry[k + 1]))))
+            k = entry.find('$', k + 1);
+         if (k == std::string::npos)
+            return std::atoi(entry.c_str());
+
+         char* end;
+         const int c = int(std::strtol(entry.c_str() + k + 1, &end, 10));
+         if ((*end == '+' || *end == '-') && std::isdigit(uint8_t(end[1])))
+            d.offset = std::strtod(end, &end);
+         while (*end == ')')
+            ++end;
+         if (*end == '*')
+            d.scale = std::strtod(end + 1, nullptr); // ($2*0.01), (($2-150)*0.01) and the delta form all end in *unit
+         d.delta = entry.find("?0:") != std::string::npos;
+         return c;
+      }
+
+      // Replaces the encoded values of a text block with what the using expressions evaluate to
+      static void decode(Series& s)
+      {
+         for (size_t k = 0; k < s.decode.size(); ++k)
+         {
+            const Decode& d = s.decode[k];
+            const int c = s.columns[k];
+            if (d.identity() || c <= 0)
+               continue;
+
+            double sum = 0.0;
+            for (auto& row : s.rows)
+            {
+               if (size_t(c) > row.size())
+                  continue;
+               double& v = row[c - 1];
+               v = d.delta ? (sum += v) * d.scale : (v + d.offset) * d.scale;
+            }
+         }
+      }
+
+      // Layout and drawing
+
+      static uint32_t defaultColor(const size_t index)
+      {
+         static const uint32_t colors[] = { 0x9400d3, 0x009e73, 0x56b4e9, 0xe69f00, 0xf0e442, 0x0072b2, 0xe51e10, 0x000000 };
+         return colors[index % (sizeof(colors) / sizeof(colors[0]))];
+      }
+
+      static double column(const std::vector<double>& row, const int c, const size_t index)
+      {
+         if (c == 0)
+            return double(index);
+         return size_t(c) <= row.size() ? row[c - 1] : std::numeric_limits<double>::quiet_NaN();
+      }
+
+      // Columns actually used by a series, defaulting like gnuplot does
+      static std::vector<int> usedColumns(const Series& s)
+      {
+         if (!s.columns.empty())
+            return s.columns;
+         for (const auto& row : s.rows)
+         {
+            if (row.size() == 1)
+               return { 0, 1 };
+            if (!row.empty())
+               break;
+         }
+         return { 1, 2 };
+      }
+
+      void extend(double& low, double& high, const double value) const
+      {
+         if (std::isfinite(value))
+         {
+            low = (std::min)(low, value);
+            high = (std::max)(high, value);
+         }
+      }
+
+      void autoscale()
+      {
+         const double inf = std::numeric_limits<double>::infinity();
+         x_min = inf, x_max = -inf, y_min = inf, y_max = -inf;
+
+         for (const auto& s : series)
+         {
+            if (s.binary)
+            {
+               if (s.style == "image" && s.array_width > 0)
+               {
+                  extend(x_min, x_max, s.origin_x - 0.5 * s.dx);
+                  extend(x_min, x_max, s.origin_x + (s.array_width - 0.5) * s.dx);
+                  extend(y_min, y_max, s.origin_y - 0.5 * s.dy);
+                  extend(y_min, y_max, s.origin_y + (s.array_height - 0.5) * s.dy);
+               }
+               continue;
+            }
+
+            const std::vector<int> c = usedColumns(s);
+            const bool vectors = s.style == "vectors" && c.size() >= 4;
+            for (size_t i = 0; i < s.rows.size(); ++i)
+            {
+               const auto& row = s.rows[i];
+               if (row.empty())
+                  continue;
+               const double x = column(row, c[0], i);
+               extend(x_min, x_max, x);
+               for (size_t k = 1; k < c.size() && !vectors; ++k)
+                  extend(y_min, y_max, column(row, c[k], i));
+               if (vectors)
+               {
+                  extend(y_min, y_max, column(row, c[1], i));
+                  extend(x_min, x_max, x + column(row, c[2], i));
+                  extend(y_min, y_max, column(row, c[1], i) + column(row, c[3], i));
+               }
+            }
+         }
+
+         if (x_min > x_max)
+            x_min = -10.0, x_max = 10.0;
+         if (y_min > y_max)
+            y_min = -10.0, y_max = 10.0;
+      }
+
+      // Tick spacing of 1, 2 or 5 times a power of ten, giving about count ticks
+      static double tickStep(const double range, const double count)
+      {
+         const double raw = range / (std::max)(count, 1.0);
+         const double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+         const double normalized = raw / magnitude;
+         return (normalized < 1.5 ? 1.0 : normalized < 3.0 ? 2.0 : normalized < 7.0 ? 5.0 : 10.0) * magnitude;
+      }
+
+      // Extends [low, high] to whole ticks, like gnuplot's autoscale
+      static double niceRange(double& low, double& high, const double count)
+      {
+         if (high - low <= std::abs(high) * 1e-12)
+         {
+            const double pad = low == 0.0 ? 1.0 : std::abs(low) * 0.1;
+            low -= pad;
+            high += pad;
+         }
+         const double step = tickStep(high - low, count);
+         low = std::floor(low / step + 1e-9) * step;
+         high = std::ceil(high / step - 1e-9) * step;
+         return step;
+      }
+
+      static std::string tickLabel(double value, const double step)
+      {
+         if (std::abs(value) < step * 1e-6)
+            value = 0.0;
+         char text[32];
+         const double magnitude = (std::max)(std::abs(value), step);
+         if (magnitude >= 1e6 || magnitude < 1e-4)
+            std::snprintf(text, sizeof(text), "%g", value);
+         else
+         {
+            const int decimals = (std::max)(0, int(-std::floor(std::log10(step) + 1e-9)));
+            std::snprintf(text, sizeof(text), "%.*f", decimals, value);
+         }
+         return text;
+      }
+
+      double px(const double x) const { return left + (x - x_min) / (x_max - x_min) * (right - left); }
+      double py(const double y) const { return bottom - (y - y_min) / (y_max - y_min) * (bottom - top); }
+
+      static Primitive line(const double x0, const double y0, const double x1, const double y1, const uint32_t color, const double width = 1.0, const bool clip = false)
+      {
+         Primitive p{ Kind::polyline };
+         p.points = { x0, y0, x1, y1 };
+         p.color = color;
+         p.width = width;
+         p.clip = clip;
+         return p;
+      }
+
+      static Primitive text(const std::string& content, const double x, const double y, const int anchor, const int scale = 1)
+      {
+         Primitive p{ Kind::text };
+         p.points = { x, y };
+         p.text = content;
+         p.anchor = anchor;
+         p.scale = scale;
+         return p;
+      }
+
+      std::vector<Primitive> layout()
+      {
+         autoscale();
+
+         const double width = double(options.width), height = double(options.height);
+         const double y_step = niceRange(y_min, y_max, height / 60.0);
+         const double x_step = niceRange(x_min, x_max, width / 90.0);
+
+         std::vector<std::pair<double, std::string>> y_ticks, x_ticks;
+         size_t label_chars = 1;
+         for (double v = y_min; v <= y_max + 0.5 * y_step; v += y_step)
+         {
+            y_ticks.emplace_back(v, tickLabel(v, y_step));
+            label_chars = (std::max)(label_chars, y_ticks.back().second.size());
+         }
+         for (double v = x_min; v <= x_max + 0.5 * x_step; v += x_step)
+            x_ticks.emplace_back(v, tickLabel(v, x_step));
+
+         const double glyph = GnuGraphFont::advance;
+         left = std::floor(label_chars * glyph + 14.0 + (ylabel.empty() ? 0.0 : 14.0)) + 0.5;
+         right = std::floor(width - 16.0) + 0.5;
+         top = std::floor(title.empty() ? 14.0 : 32.0) + 0.5;
+         bottom = std::floor(height - 22.0 - (xlabel.empty() ? 0.0 : 14.0)) + 0.5;
+
+         std::vector<Primitive> list;
+         drawSeries(list);
+
+         // border, ticks and labels on top of the data
+         Primitive border{ Kind::polyline };
+         border.points = { left, top, right, top, right, bottom, left, bottom, left, top };
+         list.push_back(border);
+
+         for (const auto& tick : y_ticks)
+         {
+            const double y = std::floor(py(tick.first)) + 0.5;
+            list.push_back(line(left, y, left + 5.0, y, 0));
+            list.push_back(line(right, y, right - 5.0, y, 0));
+            list.push_back(text(tick.second, left - 5.0, y - 3.0, 2));
+         }
+         for (const auto& tick : x_ticks)
+         {
+            const double x = std::floor(px(tick.first)) + 0.5;
+            list.push_back(line(x, bottom, x, bottom - 5.0, 0));
+            list.push_back(line(x, top, x, top + 5.0, 0));
+            list.push_back(text(tick.second, x, bottom + 6.0, 1));
+         }
+
+         if (!title.empty())
+            list.push_back(text(title, 0.5 * (left + right), 8.0, 1, 2));
+         if (!xlabel.empty())
+            list.push_back(text(xlabel, 0.5 * (left + right), height - 14.0, 1));
+         if (!ylabel.empty())
+            list.push_back(text(ylabel, 4.0, 0.5 * (top + bottom) - 3.0, 0));
+
+         drawLegend(list);
+         return list;
+      }
+
+      uint32_t seriesColor(const Series& s, const size_t index) const
+      {
+         return s.has_color ? s.color : defaultColor(index);
+      }
+
+      void drawSeries(std::vector<Primitive>& list)
+      {
+         for (size_t index = 0; index < series.size(); ++index)
+         {
+            const Series& s = series[index];
+            const uint32_t color = seriesColor(s, index);
+
+            if (s.binary)
+            {
+               if (s.style == "image")
+                  drawImage(s, list);
+               continue;
+            }
+
+            const std::vector<int> c = usedColumns(s);
+            if (startsWith(s.style, "filledcurves"))
+               drawBand(s, c, color, list);
+            else if (s.style == "vectors")
+               drawVectors(s, c, color, list);
+            else
+               drawLines(s, c, index, color, list);
+         }
+      }
+
+      void drawLines(const Series& s, const std::vector<int>& c, const size_t index, const uint32_t color, std::vector<Primitive>& list)
+      {
+         const bool lines = s.style == "lines" || s.style == "l" || s.style == "linespoints" || s.style == "lp" || startsWith(s.style, "steps");
+         const bool points = s.style == "points" || s.style == "p" || s.style == "linespoints" || s.style == "lp";
+         const bool dots = s.style == "dots";
+         const bool impulses = s.style == "impulses";
+
+         Primitive polyline{ Kind::polyline };
+         polyline.color = color;
+         polyline.width = s.line_width;
+         polyline.clip = true;
+
+         auto flush = [&]
+         {
+            if (polyline.points.size() >= 4)
+               list.push_back(polyline);
+            polyline.points.clear();
+         };
+
+         for (size_t i = 0; i < s.rows.size(); ++i)
+         {
+            const auto& row = s.rows[i];
+            const double x = column(row, c[0], i), y = c.size() > 1 ? column(row, c[1], i) : std::numeric_limits<double>::quiet_NaN();
+            if (row.empty() || !std::isfinite(x) || !std::isfinite(y))
+            {
+               flush();
+               continue;
+            }
+
+            const double X = px(x), Y = py(y);
+            if (lines || (!points && !dots && !impulses))
+            {
+               polyline.points.push_back(X);
+               polyline.points.push_back(Y);
+            }
+            if (points)
+               drawPoint(X, Y, index, color, list);
+            if (dots)
+               list.push_back(line(X - 0.5, Y, X + 0.5, Y, color, 1.0, true));
+            if (impulses)
+               list.push_back(line(X, py((std::min)((std::max)(0.0, y_min), y_max)), X, Y, color, s.line_width, true));
+         }
+         flush();
+      }
+
+      static void drawPoint(const double x, const double y, const size_t index, const uint32_t color, std::vector<Primitive>& list)
+      {
+         const double r = 3.0;
+         const size_t type = index % 4; // plus, cross, star, box
+         if (type == 0 || type == 2)
+         {
+            list.push_back(line(x - r, y, x + r, y, color, 1.0, true));
+            list.push_back(line(x, y - r, x, y + r, color, 1.0, true));
+         }
+         if (type == 1 || type == 2)
+         {
+            list.push_back(line(x - r, y - r, x + r, y + r, color, 1.0, true));
+            list.push_back(line(x - r, y + r, x + r, y - r, color, 1.0, true));
+         }
+         if (type == 3)
+         {
+            Primitive box{ Kind::polyline };
+            box.points = { x - r, y - r, x + r, y - r, x + r, y + r, x - r, y + r, x - r, y - r };
+            box.color = color;
+            box.clip = true;
+            list.push_back(box);
+         }
+      }
+
+      void drawVectors(const Series& s, const std::vector<int>& c, const uint32_t color, std::vector<Primitive>& list)
+      {
+         if (c.size() < 4)
+            return;
+
+         for (size_t i = 0; i < s.rows.size(); ++i)
+         {
+            const auto& row = s.rows[i];
+            if (row.empty())
+               continue;
+            const double x = column(row, c[0], i), y = column(row, c[1], i);
+            const double X0 = px(x), Y0 = py(y);
+            const double X1 = px(x + column(row, c[2], i)), Y1 = py(y + column(row, c[3], i));
+            if (!std::isfinite(X0 + Y0 + X1 + Y1))
+               continue;
+
+            list.push_back(line(X0, Y0, X1, Y1, color, s.line_width, true));
+
+            const double length = std::hypot(X1 - X0, Y1 - Y0);
+            if (length == 0.0)
+               continue;
+            const double ux = (X1 - X0) / length, uy = (Y1 - Y0) / length;
+            const double head = (std::min)(10.0, 0.5 * length), spread = 0.4;
+            const double ax = X1 - head * (ux - spread * uy), ay = Y1 - head * (uy + spread * ux);
+            const double bx = X1 - head * (ux + spread * uy), by = Y1 - head * (uy - spread * ux);
+
+            Primitive arrow{ s.filled_head ? Kind::polygon : Kind::polyline };
+            arrow.points = { ax, ay, X1, Y1, bx, by };
+            if (s.filled_head)
+               arrow.points.insert(arrow.points.end(), { ax, ay });
+            arrow.color = color;
+            arrow.width = s.line_width;
+            arrow.clip = true;
+            list.push_back(arrow);
+         }
+      }
+
+      // filledcurves between columns 2 and 3, or between the curve and y = 0 with two columns
+      void drawBand(const Series& s, const std::vector<int>& c, const uint32_t color, std::vector<Primitive>& list)
+      {
+         Primitive band{ Kind::polygon };
+         band.color = color;
+         band.opacity = s.fill_opacity;
+         band.clip = true;
+         std::vector<double> upper;
+
+         auto flush = [&]
+         {
+            for (size_t k = upper.size(); k >= 2; k -= 2)
+            {
+               band.points.push_back(upper[k - 2]);
+               band.points.push_back(upper[k - 1]);
+            }
+            if (band.points.size() >= 6)
+               list.push_back(band);
+            band.points.clear();
+            upper.clear();
+         };
+
+         for (size_t i = 0; i < s.rows.size(); ++i)
+         {
+            const auto& row = s.rows[i];
+            const double x = column(row, c[0], i);
+            const double low = c.size() > 2 ? column(row, c[1], i) : 0.0;
+            const double high = c.size() > 2 ? column(row, c[2], i) : (c.size() > 1 ? column(row, c[1], i) : std::numeric_limits<double>::quiet_NaN());
+            if (row.empty() || !std::isfinite(x) || !std::isfinite(low) || !std::isfinite(high))
+            {
+               flush();
+               continue;
+            }
+            band.points.push_back(px(x));
+            band.points.push_back(py(low));
+            upper.push_back(px(x));
+            upper.push_back(py(high));
+         }
+         flush();
+      }
+
+      // gnuplot's default palette, rgbformulae 7,5,15
+      static uint32_t palette(double v)
+      {
+         v = (std::min)(1.0, (std::max)(0.0, v));
+         const double r = std::sqrt(v), g = v * v * v, b = (std::max)(0.0, std::sin(2.0 * 3.14159265358979 * v));
+         return (uint32_t(r * 255.0 + 0.5) << 16) | (uint32_t(g * 255.0 + 0.5) << 8) | uint32_t(b * 255.0 + 0.5);
+      }
+
+      void drawImage(const Series& s, std::vector<Primitive>& list)
+      {
+         if (s.values.size() < s.array_width * s.array_height)
+            return;
+
+         float low = std::numeric_limits<float>::infinity(), high = -low;
+         for (const float v : s.values)
+         {
+            if (std::isfinite(v))
+            {
+               low = (std::min)(low, v);
+               high = (std::max)(high, v);
+            }
+         }
+         const double range = high > low ? high - low : 1.0;
+
+         // one primitive for the whole array, rasterised once instead of a rect per cell
+         Primitive image{ Kind::image };
+         image.image_width = s.array_width;
+         image.image_height = s.array_height;
+         image.rgba.assign(s.array_width * s.array_height * 4, 0);
+         for (size_t row = 0; row < s.array_height; ++row)
+         {
+            uint8_t* out = &image.rgba[(s.array_height - 1 - row) * s.array_width * 4]; // the first array row is at the bottom
+            for (size_t col = 0; col < s.array_width; ++col, out += 4)
+            {
+               const float v = s.values[row * s.array_width + col];
+               if (!std::isfinite(v))
+                  continue;
+               const uint32_t color = palette((v - low) / range);
+               out[0] = uint8_t(color >> 16);
+               out[1] = uint8_t(color >> 8);
+               out[2] = uint8_t(color);
+               out[3] = 255;
+            }
+         }
+
+         const double x0 = px(s.origin_x - 0.5 * s.dx), x1 = px(s.origin_x + (s.array_width - 0.5) * s.dx);
+         const double y0 = py(s.origin_y - 0.5 * s.dy), y1 = py(s.origin_y + (s.array_height - 0.5) * s.dy);
+         image.points = { x0, y1, x1 - x0, y0 - y1 };
+         image.clip = true;
+         list.push_back(std::move(image));
+      }
+
+      void drawLegend(std::vector<Primitive>& list)
+      {
+         // an opaque box keeps the titles readable over images and dense data, like gnuplot's 'set key box opaque'
+         size_t entries = 0, longest = 0;
+         for (const auto& s : series)
+         {
+            if (!s.title.empty())
+            {
+               ++entries;
+               longest = (std::max)(longest, s.title.size());
+            }
+         }
+         if (entries == 0)
+            return;
+
+         const double box_left = right - 52.0 - double(longest * GnuGraphFont::advance);
+         Primitive box{ Kind::rect };
+         box.points = { box_left, top + 2.0, right - 4.0 - box_left, 12.0 * entries + 4.0 };
+         box.color = 0xffffff;
+         box.opacity = 0.85;
+         list.push_back(box);
+
+         double y = top + 10.0;
+         for (size_t index = 0; index < series.size(); ++index)
+         {
+            const Series& s = series[index];
+            if (s.title.empty())
+               continue;
+
+            const uint32_t color = seriesColor(s, index);
+            list.push_back(text(s.title, right - 48.0, y - 3.0, 2));
+
+            if (s.style == "image")
+            {
+               // a sample of the palette, low to high
+               const size_t steps = 10;
+               for (size_t k = 0; k < steps; ++k)
+               {
+                  Primitive swatch{ Kind::rect };
+                  swatch.points = { right - 40.0 + 3.0 * k, y - 4.0, 3.0, 8.0 };
+                  swatch.color = palette((k + 0.5) / steps);
+                  list.push_back(swatch);
+               }
+            }
+            else if (startsWith(s.style, "filledcurves"))
+            {
+               Primitive swatch{ Kind::rect };
+               swatch.points = { right - 40.0, y - 4.0, 30.0, 8.0 };
+               swatch.color = color;
+               swatch.opacity = s.fill_opacity;
+               list.push_back(swatch);
+            }
+            else if (s.style == "points" || s.style == "p")
+               drawPoint(right - 25.0, y, index, color, list);
+            else
+               list.push_back(line(right - 40.0, y, right - 10.0, y, color, s.line_width));
+
+            y += 12.0;
+         }
+      }
+
+      // Output
+
+      void render()
+      {
+         const std::vector<Primitive> list = layout();
+
+         std::string file = output;
+         const size_t number = file.find("%d"); // only this token, the rest of the path is taken literally
+         if (number != std::string::npos)
+            file.replace(number, 2, std::to_string(++frame));
+
+         const size_t dot = file.rfind('.');
+         std::string extension = dot == std::string::npos ? "" : file.substr(dot);
+         for (auto& c : extension)
+            c = char(std::tolower(uint8_t(c)));
+
+         std::string encoded;
+         if (extension == ".svg")
+            encoded = svg(list);
+         else
+         {
+            if (extension != ".png")
+               messages += "GnuGraphRenderer: only png and svg output are supported, writing png data to " + file + "\n";
+            encoded = png(list);
+         }
+
+         std::FILE* f = std::fopen(file.c_str(), "wb");
+         if (!f)
+         {
+            messages += "GnuGraphRenderer: unable to open " + file + "\n";
+            return;
+         }
+         std::fwrite(encoded.data(), 1, encoded.size(), f);
+         std::fclose(f);
+      }
+
+      // Raster output, antialiased lines (Wu's algorithm) alpha blended on a white background
+
+      struct Canvas
+      {
+         Canvas(const size_t width, const size_t height) : width(width), height(height), rgb(width * height * 3, 255) {}
+
+         size_t width, height;
+         std::vector<uint8_t> rgb;
+         double clip_left = 0, clip_top = 0, clip_right = 0, clip_bottom = 0;
+         bool clipping = false;
+
+         void blend(const int x, const int y, const uint32_t color, const double alpha)
+         {
+            if (x < 0 || y < 0 || size_t(x) >= width || size_t(y) >= height || alpha <= 0.0)
+               return;
+            if (clipping && (x < clip_left || x > clip_right || y < clip_top || y > clip_bottom))
+               return;
+
+            uint8_t* p = &rgb[(size_t(y) * width + size_t(x)) * 3];
+            const double a = (std::min)(alpha, 1.0);
+            p[0] = uint8_t(p[0] + ((int((color >> 16) & 0xff) - p[0]) * a));
+            p[1] = uint8_t(p[1] + ((int((color >> 8) & 0xff) - p[1]) * a));
+            p[2] = uint8_t(p[2] + ((int(color & 0xff) - p[2]) * a));
+         }
+
+         void wuLine(double x0, double y0, double x1, double y1, const uint32_t color, const double alpha)
+         {
+            const bool steep = std::abs(y1 - y0) > std::abs(x1 - x0);
+            if (steep)
+            {
+               std::swap(x0, y0);
+               std::swap(x1, y1);
+            }
+            if (x0 > x1)
+            {
+               std::swap(x0, x1);
+               std::swap(y0, y1);
+            }
+
+            // pixel centres are at integer + 0.5
+            x0 -= 0.5, y0 -= 0.5, x1 -= 0.5, y1 -= 0.5;
+            const double dx = x1 - x0;
+            const double gradient = dx == 0.0 ? 1.0 : (y1 - y0) / dx;
+
+            const int start = int(std::ceil(x0)), end = int(std::floor(x1));
+            if (end < start) // shorter than a pixel
+            {
+               plot(steep, int(std::floor(0.5 * (x0 + x1) + 0.5)), int(std::floor(0.5 * (y0 + y1) + 0.5)), color, alpha * (x1 - x0));
+               return;
+            }
+
+            double y = y0 + gradient * (start - x0);
+            for (int x = start; x <= end; ++x, y += gradient)
+            {
+               const double base = std::floor(y);
+               const double f = y - base;
+               plot(steep, x, int(base), color, alpha * (1.0 - f));
+               plot(steep, x, int(base) + 1, color, alpha * f);
+            }
+         }
+
+         void plot(const bool steep, const int x, const int y, const uint32_t color, const double alpha)
+         {
+            if (steep)
+               blend(y, x, color, alpha);
+            else
+               blend(x, y, color, alpha);
+         }
+
+         void thickLine(const double x0, const double y0, const double x1, const double y1, const uint32_t color, const double width, const double alpha)
+         {
+            const int passes = (std::max)(1, int(width + 0.5));
+            if (passes == 1)
+            {
+               wuLine(x0, y0, x1, y1, color, alpha);
+               return;
+            }
+
+            const double length = std::hypot(x1 - x0, y1 - y0);
+            const double nx = length > 0.0 ? -(y1 - y0) / length : 0.0, ny = length > 0.0 ? (x1 - x0) / length : 1.0;
+            for (int k = 0; k < passes; ++k)
+            {
+               const double offset = k - 0.5 * (passes - 1);
+               wuLine(x0 + nx * offset, y0 + ny * offset, x1 + nx * offset, y1 + ny * offset, color, alpha);
+            }
+         }
+
+         // Nearest cell at each pixel centre of the x, y, w, h destination
+         void image(const Primitive& p)
+         {
+            const double x0 = p.points[0], y0 = p.points[1], w = p.points[2], h = p.points[3];
+            if (!(w > 0.0 && h > 0.0) || p.image_width == 0 || p.image_height == 0)
+               return;
+
+            const int first_y = (std::max)(0, int(std::ceil(y0 - 0.5))), last_y = (std::min)(int(height) - 1, int(std::floor(y0 + h - 0.5)));
+            const int first_x = (std::max)(0, int(std::ceil(x0 - 0.5))), last_x = (std::min)(int(width) - 1, int(std::floor(x0 + w - 0.5)));
+            for (int y = first_y; y <= last_y; ++y)
+            {
+               const size_t row = (std::min)(p.image_height - 1, size_t((y + 0.5 - y0) / h * double(p.image_height)));
+               for (int x = first_x; x <= last_x; ++x)
+               {
+                  const size_t col = (std::min)(p.image_width - 1, size_t((x + 0.5 - x0) / w * double(p.image_width)));
+                  const uint8_t* c = &p.rgba[(row * p.image_width + col) * 4];
+                  blend(x, y, uint32_t(c[0]) << 16 | uint32_t(c[1]) << 8 | c[2], c[3] / 255.0);
+               }
+            }
+         }
+
+         // Even-odd scanline fill sampled at pixel centres
+         void fill(const std::vector<double>& points, const uint32_t color, const double alpha)
+         {
+            const size_t n = points.size() / 2;
+            double low = std::numeric_limits<double>::infinity(), high = -low;
+            for (size_t i = 0; i < n; ++i)
+            {
+               low = (std::min)(low, points[2 * i + 1]);
+               high = (std::max)(high, points[2 * i + 1]);
+            }
+
+            std::vector<double> crossings;
+            const int first = (std::max)(0, int(std::floor(low))), last = (std::min)(int(height) - 1, int(std::ceil(high)));
+            for (int y = first; y <= last; ++y)
+            {
+               const double cy = y + 0.5;
+               crossings.clear();
+               for (size_t i = 0, j = n - 1; i < n; j = i++)
+               {
+                  const double xi = points[2 * i], yi = points[2 * i + 1], xj = points[2 * j], yj = points[2 * j + 1];
+                  if ((yi <= cy) != (yj <= cy))
+                     crossings.push_back(xi + (cy - yi) / (yj - yi) * (xj - xi));
+               }
+               std::sort(crossings.begin(), crossings.end());
+               for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+               {
+                  for (int x = (std::max)(0, int(std::ceil(crossings[k] - 0.5))); x <= int(std::floor(crossings[k + 1] - 0.5)) && x < int(width); ++x)
+                     blend(x, y, color, alpha);
+               }
+            }
+         }
+
+         void glyphs(const std::string& content, double x, const double y, const int anchor, const int scale)
+         {
+            const double length = double(content.size() * GnuGraphFont::advance * scale);
+            x -= anchor == 1 ? 0.5 * length : anchor == 2 ? length : 0.0;
+
+            int cx = int(std::floor(x));
+            const int cy = int(std::floor(y));
+            for (const char c : content)
+            {
+               const uint8_t* g = GnuGraphFont::glyph(c);
+               for (int col = 0; col < GnuGraphFont::width; ++col)
+               {
+                  for (int row = 0; row < GnuGraphFont::height; ++row)
+                  {
+                     if (!((g[col] >> row) & 1))
+                        continue;
+                     for (int sy = 0; sy < scale; ++sy)
+                     {
+                        for (int sx = 0; sx < scale; ++sx)
+                           blend(cx + col * scale + sx, cy + row * scale + sy, 0, 1.0);
+                     }
+                  }
+               }
+               cx += GnuGraphFont::advance * scale;
+            }
+         }
+      };
+
+      std::string png(const std::vector<Primitive>& list) const
+      {
+         Canvas canvas(options.width, options.height);
+         canvas.clip_left = left, canvas.clip_top = top, canvas.clip_right = right, canvas.clip_bottom = bottom;
+
+         for (const auto& p : list)
+         {
+            canvas.clipping = p.clip;
+            switch (p.kind)
+            {
+            case Kind::polyline:
+               for (size_t i = 0; i + 3 < p.points.size(); i += 2)
+                  canvas.thickLine(p.points[i], p.points[i + 1], p.points[i + 2], p.points[i + 3], p.color, p.width, p.opacity);
+               break;
+            case Kind::polygon:
+               canvas.fill(p.points, p.color, p.opacity);
+               break;
+            case Kind::rect:
+               canvas.fill({ p.points[0], p.points[1], p.points[0] + p.points[2], p.points[1], p.points[0] + p.points[2], p.points[1] + p.points[3], p.points[0], p.points[1] + p.points[3] }, p.color, p.opacity);
+               break;
+            case Kind::text:
+               canvas.glyphs(p.text, p.points[0], p.points[1], p.anchor, p.scale);
+               break;
+            case Kind::image:
+               canvas.image(p);
+               break;
+            }
+         }
+
+         return GnuGraphPng::encode(canvas.rgb.data(), options.width, options.height);
+      }
+
+      // Vector output
+
+      static std::string svgColor(const uint32_t color)
+      {
+         char text[8];
+         std::snprintf(text, sizeof(text), "#%06x", color & 0xffffff);
+         return text;
+      }
+
+      static std::string escape(const std::string& content)
+      {
+         std::string result;
+         for (const char c : content)
+         {
+            if (c == '<')
+               result += "&lt;";
+            else if (c == '>')
+               result += "&gt;";
+            else if (c == '&')
+               result += "&amp;";
+            else
+               result += c;
+         }
+         return result;
+      }
+
+      static std::string base64(const std::string& data)
+      {
+         static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+         std::string result;
+         result.reserve((data.size() + 2) / 3 * 4);
+         for (size_t i = 0; i < data.size(); i += 3)
+         {
+            const size_t n = std::min<size_t>(3, data.size() - i);
+            uint32_t bits = uint32_t(uint8_t(data[i])) << 16;
+            if (n > 1)
+               bits |= uint32_t(uint8_t(data[i + 1])) << 8;
+            if (n > 2)
+               bits |= uint8_t(data[i + 2]);
+            for (size_t k = 0; k < 4; ++k)
+               result += k <= n ? digits[(bits >> (18 - 6 * k)) & 63] : '=';
+         }
+         return result;
+      }
+
+      // An image primitive as an embedded png, one pixel per cell with missing cells left white
+      static std::string imagePng(const Primitive& p)
+      {
+         std::vector<uint8_t> rgb(p.image_width * p.image_height * 3);
+         for (size_t i = 0; i < p.image_width * p.image_height; ++i)
+         {
+            const uint8_t* c = &p.rgba[i * 4];
+            for (size_t k = 0; k < 3; ++k)
+               rgb[i * 3 + k] = c[3] ? c[k] : 255;
+         }
+         return GnuGraphPng::encode(rgb.data(), p.image_width, p.image_height);
+      }
+
+      std::string svg(const std::vector<Primitive>& list) const
+      {
+         std::ostringstream out;
+         out.precision(6);
+         out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << options.width << "\" height=\"" << options.height << "\">\n";
+         out << "<defs><clipPath id=\"plot\"><rect x=\"" << left << "\" y=\"" << top << "\" width=\"" << right - left << "\" height=\"" << bottom - top << "\"/></clipPath></defs>\n";
+         out << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+
+         for (const auto& p : list)
+         {
+            const std::string clip = p.clip ? " clip-path=\"url(#plot)\"" : "";
+            switch (p.kind)
+            {
+            case Kind::polyline:
+            case Kind::polygon:
+               out << (p.kind == Kind::polyline ? "<polyline" : "<polygon") << " points=\"";
+               for (size_t i = 0; i + 1 < p.points.size(); i += 2)
+                  out << (i ? " " : "") << p.points[i] << "," << p.points[i + 1];
+               if (p.kind == Kind::polyline)
+                  out << "\" fill=\"none\" stroke=\"" << svgColor(p.color) << "\" stroke-width=\"" << p.width << "\"";
+               else
+                  out << "\" fill=\"" << svgColor(p.color) << "\" fill-opacity=\"" << p.opacity << "\"";
+               out << clip << "/>\n";
+               break;
+            case Kind::rect:
+               out << "<rect x=\"" << p.points[0] << "\" y=\"" << p.points[1] << "\" width=\"" << p.points[2] << "\" height=\"" << p.points[3]
+                  << "\" fill=\"" << svgColor(p.color) << "\" fill-opacity=\"" << p.opacity << "\"" << clip << "/>\n";
+               break;
+            case Kind::text:
+               out << "<text x=\"" << p.points[0] << "\" y=\"" << p.points[1] + GnuGraphFont::height * p.scale << "\" font-family=\"sans-serif\" font-size=\"" << 10 * p.scale
+                  << "\" text-anchor=\"" << (p.anchor == 1 ? "middle" : p.anchor == 2 ? "end" : "start") << "\">" << escape(p.text) << "</text>\n";
+               break;
+            case Kind::image:
+               out << "<image x=\"" << p.points[0] << "\" y=\"" << p.points[1] << "\" width=\"" << p.points[2] << "\" height=\"" << p.points[3]
+                  << "\" preserveAspectRatio=\"none\" style=\"image-rendering:pixelated\"" << clip
+                  << " href=\"data:image/png;base64," << base64(imagePng(p)) << "\"/>\n";
+               break;
+            }
+         }
+
+         out << "</svg>\n";
+         return out.str();
+      }
+   };
+}
\ No newline at end of file
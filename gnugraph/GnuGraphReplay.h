@@ -0,0 +1,116 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Feeds a session recorded with GnuGraphRecorder back into gnuplot
+
+#include "gnugraph/GnuGraphPiping.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+namespace gnugraph
+{
+   struct GnuGraphReplay : public GnuGraphPiping
+   {
+      struct Options
+      {
+         bool real_time = false; // honour the recorded frame timestamps, otherwise replay as fast as gnuplot accepts
+         double speed = 1.0; // real time playback rate, must be positive
+         std::string headless_output{}; // if set, every plot is rendered to <headless_output>NNNNN.png (its directory is created) instead of a window
+         std::string headless_terminal = "pngcairo";
+      };
+
+      GnuGraphReplay(const std::string& gnuplot_exe_path = "C:/Program Files/gnuplot/bin/gnuplot.exe") : GnuGraphPiping(gnuplot_exe_path) {}
+
+      std::string replay(const std::string& log_file)
+      {
+         return replay(log_file, Options{});
+      }
+
+      // Replays the whole log and returns everything gnuplot replied
+      std::string replay(const std::string& log_file, const Options& options)
+      {
+         if (options.real_time && !(options.speed > 0.0))
+            throw std::runtime_error("GnuGraphReplay: speed must be positive");
+
+         GnuGraphRecording recording(log_file);
+
+         const bool headless = !options.headless_output.empty();
+         std::string result;
+         if (headless)
+         {
+            const std::filesystem::path directory = std::filesystem::path(options.headless_output).parent_path();
+            if (!directory.empty())
+               std::filesystem::create_directories(directory);
+
+            write("set terminal " + options.headless_terminal + "\n");
+            result += read();
+         }
+
+         const auto start = std::chrono::steady_clock::now();
+         size_t frame_id = 0;
+
+         GnuGraphRecording::Frame frame;
+         while (recording.next(frame))
+         {
+            if (frame.command == "quit\n")
+               continue; // the replay owns the gnuplot process
+
+            if (headless && isOutputCommand(frame.command))
+               continue; // recorded terminal choices are replaced by the headless output
+
+            if (options.real_time)
+            {
+               const auto due = std::chrono::nanoseconds(uint64_t(frame.time / options.speed));
+               std::this_thread::sleep_until(start + due);
+            }
+
+            if (headless && isPlotCommand(frame.command))
+            {
+               const std::string frame_number = std::to_string(++frame_id);
+               write("set output '" + options.headless_output + std::string(frame_number.length() < 5 ? 5 - frame_number.length() : 0, '0') + frame_number + ".png'\n");
+            }
+
+            write(frame.command);
+            result += read();
+         }
+
+         if (headless)
+         {
+            write("unset output\n");
+            result += read();
+         }
+
+         return result;
+      }
+
+   private:
+      static bool startsWith(const std::string& command, const char* prefix)
+      {
+         return command.compare(0, std::strlen(prefix), prefix) == 0;
+      }
+
+      static bool isPlotCommand(const std::string& command)
+      {
+         return startsWith(command, "plot ") || startsWith(command, "splot ") || startsWith(command, "replot");
+      }
+
+      static bool isOutputCommand(const std::string& command)
+      {
+         return startsWith(command, "set terminal") || startsWith(command, "set output") || startsWith(command, "unset output");
+      }
+   };
+}
\ No newline at end of file
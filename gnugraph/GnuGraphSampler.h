@@ -0,0 +1,280 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Adaptive sampling of callables: dense where the curve bends or jumps, sparse where it is straight
+
+#include "gnugraph/GnuGraphParallel.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace gnugraph
+{
+   struct GnuGraphSampler
+   {
+      struct Options
+      {
+         size_t width = 800; // output resolution in pixels
+         size_t height = 600;
+         double tolerance = 0.5; // allowed distance between the curve and the drawn polyline, in pixels
+         size_t initial = 64; // uniform intervals before refinement
+         double samples_per_pixel = 4.0; // sample budget and finest spacing, per pixel of width
+         size_t grain = 256; // evaluations per thread worth spawning for, lower it for expensive models, 0 stays serial
+      };
+
+      // Samples y = f(x) over [x_min, x_max]. f is either double(double), or void(const double* x, size_t n, double* y)
+      //    which is handed contiguous batches of abscissae. Where f jumps, a NaN y marks the break.
+      //    f is called from several threads at once, so it must be thread-safe, unless options.grain is 0.
+      template <typename F>
+      static void sample(F f, const double x_min, const double x_max, const Options& options, std::vector<double>& x, std::vector<double>& y)
+      {
+         std::vector<double> values;
+         refine<2>([&f, &options](const std::vector<double>& t, double* out)
+         {
+            std::vector<double> fx(t.size());
+            GnuGraphParallel::forRanges(t.size(), ranges(t.size(), options), [&](size_t, const size_t begin, const size_t end)
+            {
+               if constexpr (std::is_invocable<F&, const double*, size_t, double*>::value)
+                  f(t.data() + begin, end - begin, fx.data() + begin);
+               else
+               {
+                  for (size_t i = begin; i < end; ++i)
+                     fx[i] = double(f(t[i]));
+               }
+            });
+
+            for (size_t i = 0; i < t.size(); ++i)
+            {
+               out[2 * i] = t[i];
+               out[2 * i + 1] = fx[i];
+            }
+         }, x_min, x_max, options, { double(options.width), double(options.height) }, x, values);
+
+         y.resize(x.size());
+         for (size_t i = 0; i < x.size(); ++i)
+            y[i] = values[2 * i + 1];
+      }
+
+      // Samples a parametric 3D curve p = f(t) over [t_min, t_max], f returns an indexable point (i.e. Eigen::Vector3d).
+      //    As for sample, f must be thread-safe unless options.grain is 0.
+      template <typename F>
+      static void sample3D(F f, const double t_min, const double t_max, const Options& options, std::vector<std::array<double, 3>>& points)
+      {
+         const double pixels = double((std::min)(options.width, options.height));
+
+         std::vector<double> t, values;
+         refine<3>([&f, &options](const std::vector<double>& t, double* out)
+         {
+            GnuGraphParallel::forRanges(t.size(), ranges(t.size(), options), [&](size_t, const size_t begin, const size_t end)
+            {
+               for (size_t i = begin; i < end; ++i)
+               {
+                  const auto p = f(t[i]);
+                  for (size_t d = 0; d < 3; ++d)
+                     out[3 * i + d] = double(p[d]);
+               }
+            });
+         }, t_min, t_max, options, { pixels, pixels, pixels }, t, values);
+
+         points.resize(t.size());
+         for (size_t i = 0; i < t.size(); ++i)
+            points[i] = { values[3 * i], values[3 * i + 1], values[3 * i + 2] };
+      }
+
+   private:
+      // A grain of 0 evaluates everything on the calling thread
+      static size_t ranges(const size_t n, const Options& options)
+      {
+         return options.grain == 0 ? 1 : GnuGraphParallel::ranges(n, options.grain);
+      }
+
+      // Refines the parameter t over [t_min, t_max] until every interval's midpoint lies within tolerance pixels of
+      //    its chord (such midpoints are evaluated but not kept), the spacing reaches 1 / samples_per_pixel pixels, or the sample budget runs out.
+      //    evaluate(t, out) writes D values per parameter, scaled to pixels by pixels[d] over the extent of dimension d.
+      template <size_t D, typename Evaluate>
+      static void refine(Evaluate evaluate, const double t_min, const double t_max, const Options& options,
+         const std::array<double, D>& pixels, std::vector<double>& t, std::vector<double>& values)
+      {
+         if (!(t_max > t_min) || options.initial == 0)
+            throw std::runtime_error("GnuGraphSampler: empty range");
+
+         const size_t budget = (std::max)(options.initial + 1, size_t(options.samples_per_pixel * options.width));
+         const double min_step = (t_max - t_min) / (options.samples_per_pixel * options.width);
+
+         t.resize(options.initial + 1);
+         for (size_t i = 0; i <= options.initial; ++i)
+            t[i] = t_min + (t_max - t_min) * i / options.initial;
+         values.resize(D * t.size());
+         evaluate(t, values.data());
+
+         std::vector<size_t> candidates(options.initial); // left index of each interval to test
+         for (size_t i = 0; i < candidates.size(); ++i)
+            candidates[i] = i;
+
+         std::vector<double> mid_t, mid_values, next_t, next_values;
+         std::vector<size_t> next_candidates;
+         const double nan = std::numeric_limits<double>::quiet_NaN();
+
+         while (!candidates.empty() && t.size() < budget)
+         {
+            const std::array<double, D> scale = pixelScale<D>(values, pixels);
+
+            // over budget, spend what is left on the longest chords
+            const size_t remaining = budget - t.size();
+            if (candidates.size() > remaining)
+            {
+               std::vector<double> chords(t.size(), 0.0);
+               for (const size_t i : candidates)
+                  chords[i] = chord<D>(&values[D * i], &values[D * (i + 1)], scale);
+               std::partial_sort(candidates.begin(), candidates.begin() + remaining, candidates.end(), [&](const size_t a, const size_t b) { return chords[a] > chords[b]; });
+               candidates.resize(remaining);
+               std::sort(candidates.begin(), candidates.end());
+            }
+
+            mid_t.resize(candidates.size());
+            for (size_t c = 0; c < candidates.size(); ++c)
+               mid_t[c] = 0.5 * (t[candidates[c]] + t[candidates[c] + 1]);
+            mid_values.resize(D * mid_t.size());
+            evaluate(mid_t, mid_values.data());
+
+            // merge the midpoints of intervals that are still not straight in, queueing both halves for another pass
+            next_t.clear();
+            next_values.clear();
+            next_candidates.clear();
+            size_t c = 0;
+            for (size_t i = 0; i < t.size(); ++i)
+            {
+               next_t.push_back(t[i]);
+               next_values.insert(next_values.end(), &values[D * i], &values[D * (i + 1)]);
+
+               if (c == candidates.size() || candidates[c] != i)
+                  continue;
+
+               const double* a = &values[D * i];
+               const double* mid = &mid_values[D * c];
+               const double* b = &values[D * (i + 1)];
+               const bool refine_more = deviation<D>(a, mid, b, scale) > options.tolerance;
+               const bool finest = 0.5 * (t[i + 1] - t[i]) < min_step;
+
+               // At the finest spacing a jump still has nearly all of its chord in one half, where a steep but
+               //    continuous curve splits it. Break the curve there with a NaN point so no connector is drawn.
+               const double whole = chord<D>(a, b, scale);
+               const double first = chord<D>(a, mid, scale);
+               const double second = chord<D>(mid, b, scale);
+               const bool jump = refine_more && finest && whole > 2.0 * options.tolerance && (std::max)(first, second) > 0.9 * whole;
+
+               if (jump && first > second)
+               {
+                  next_t.push_back(0.5 * (t[i] + mid_t[c]));
+                  next_values.insert(next_values.end(), D, nan);
+               }
+
+               // a midpoint that is already on the chord adds bytes but no fidelity
+               if (refine_more)
+               {
+                  next_t.push_back(mid_t[c]);
+                  next_values.insert(next_values.end(), mid, mid + D);
+               }
+
+               if (jump && second >= first)
+               {
+                  next_t.push_back(0.5 * (mid_t[c] + t[i + 1]));
+                  next_values.insert(next_values.end(), D, nan);
+               }
+
+               if (refine_more && !finest)
+               {
+                  next_candidates.push_back(next_t.size() - 2);
+                  next_candidates.push_back(next_t.size() - 1);
+               }
+               ++c;
+            }
+
+            t.swap(next_t);
+            values.swap(next_values);
+            candidates.swap(next_candidates);
+         }
+      }
+
+      template <size_t D>
+      static std::array<double, D> pixelScale(const std::vector<double>& values, const std::array<double, D>& pixels)
+      {
+         std::array<double, D> low, high, scale;
+         low.fill(std::numeric_limits<double>::infinity());
+         high.fill(-std::numeric_limits<double>::infinity());
+         for (size_t i = 0; i < values.size(); i += D)
+         {
+            for (size_t d = 0; d < D; ++d)
+            {
+               if (std::isfinite(values[i + d]))
+               {
+                  low[d] = (std::min)(low[d], values[i + d]);
+                  high[d] = (std::max)(high[d], values[i + d]);
+               }
+            }
+         }
+
+         for (size_t d = 0; d < D; ++d)
+            scale[d] = high[d] > low[d] ? pixels[d] / (high[d] - low[d]) : 0.0;
+         return scale;
+      }
+
+      template <size_t D>
+      static bool finite(const double* p)
+      {
+         for (size_t d = 0; d < D; ++d)
+         {
+            if (!std::isfinite(p[d]))
+               return false;
+         }
+         return true;
+      }
+
+      template <size_t D>
+      static double chord(const double* a, const double* b, const std::array<double, D>& scale)
+      {
+         if (!finite<D>(a) || !finite<D>(b))
+            return 0.0;
+
+         double squared = 0.0;
+         for (size_t d = 0; d < D; ++d)
+            squared += (b[d] - a[d]) * (b[d] - a[d]) * scale[d] * scale[d];
+         return std::sqrt(squared);
+      }
+
+      // Pixel distance between the midpoint sample and the chord midpoint, infinite at the edge of an undefined region
+      template <size_t D>
+      static double deviation(const double* a, const double* mid, const double* b, const std::array<double, D>& scale)
+      {
+         const bool fa = finite<D>(a), fm = finite<D>(mid), fb = finite<D>(b);
+         if (!fa && !fm && !fb)
+            return 0.0;
+         if (!fa || !fm || !fb)
+            return std::numeric_limits<double>::infinity();
+
+         double squared = 0.0;
+         for (size_t d = 0; d < D; ++d)
+         {
+            const double offset = (mid[d] - 0.5 * (a[d] + b[d])) * scale[d];
+            squared += offset * offset;
+         }
+         return std::sqrt(squared);
+      }
+   };
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+// Copyright (c) 2016-2017 Anyar, Inc.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//      http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a session recorded with GnuGraph(gnugraph::GnuGraphRecorder::Options{ ... })
+// 
+// usage: gnugraph-replay <log> [--gnuplot <path>] [--realtime] [--speed <rate>] [--headless <output prefix>]
+
+#include "gnugraph/GnuGraphReplay.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      cout << "usage: gnugraph-replay <log> [--gnuplot <path>] [--realtime] [--speed <rate>] [--headless <output prefix>]\n";
+      return 1;
+   }
+
+   string log_file = argv[1];
+   string gnuplot_exe = "C:/Program Files/gnuplot/bin/gnuplot.exe";
+   gnugraph::GnuGraphReplay::Options options;
+
+   for (int i = 2; i < argc; ++i)
+   {
+      const string arg = argv[i];
+      const bool has_value = i + 1 < argc;
+      if (arg == "--gnuplot" && has_value)
+         gnuplot_exe = argv[++i];
+      else if (arg == "--realtime")
+         options.real_time = true;
+      else if (arg == "--speed" && has_value)
+      {
+         options.real_time = true;
+         options.speed = atof(argv[++i]);
+         if (!(options.speed > 0.0))
+         {
+            cout << "--speed needs a positive rate\n";
+            return 1;
+         }
+      }
+      else if (arg == "--headless" && has_value)
+         options.headless_output = argv[++i];
+      else
+      {
+         cout << "unknown argument: " << arg << '\n';
+         return 1;
+      }
+   }
+
+   try
+   {
+      gnugraph::GnuGraphReplay replay(gnuplot_exe);
+      cout << replay.replay(log_file, options) << '\n';
+
+      if (options.headless_output.empty())
+      {
+         cout << "Press ENTER to exit . . ." << '\n';
+         cin.get();
+      }
+   }
+   catch (const exception& e)
+   {
+      cout << e.what() << '\n';
+      return 1;
+   }
+
+   return 0;
+}
\ No newline at end of file